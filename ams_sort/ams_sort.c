@@ -0,0 +1,512 @@
+#include "ams_sort.h"
+#include "serial_qsort.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <mpi.h>
+
+//Samples drawn per group at each level, spread over the processes by their list sizes
+#define AMS_OVERSAMPLE		64
+//Buckets per group; groups take whole buckets, chosen by their exact sizes
+#define AMS_OVERPARTITION	8
+
+#define AMS_TAG				0
+
+//Splitter ordered by key, then by the rank and index of the element it was sampled
+//from, which makes every element distinct so runs of equal keys can be split
+typedef struct {
+	int key;
+	int rank;
+	size_t index;
+} ams_splitter;
+
+//Piece of a bucket on its way to this process
+typedef struct {
+	MPI_Message message;
+	int source;
+	size_t count;
+} ams_piece;
+
+static size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz);
+static void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz);
+static size_t sort_level(int **my_arr, size_t count, int groups, MPI_Comm comm);
+
+static void select_splitters(int my_arr[], size_t count, ams_splitter splitters[],
+	int n_buckets, int my_rank, int comm_sz, MPI_Comm comm);
+static void bucket(int arr[], size_t count, ams_splitter splitters[], size_t bounds[],
+	int n_buckets, int my_rank);
+static size_t exchange(int **my_arr, size_t bounds[], int n_buckets, int groups,
+	int my_rank, int comm_sz, MPI_Comm comm);
+static void assign_buckets(size_t totals[], int n_buckets, int cuts[], int groups,
+	int comm_sz);
+static int *merge_runs(int arr[], int scratch[], size_t bounds[], int n_runs);
+
+static int group_start(int group, int groups, int comm_sz);
+static int group_of(int rank, int groups, int comm_sz);
+static size_t lower_bound(int arr[], size_t count, int key);
+static size_t upper_bound(int arr[], size_t count, int key);
+static MPI_Datatype splitter_type(void);
+static int splitter_cmp(const void *a, const void *b);
+static int piece_cmp(const void *a, const void *b);
+static uint64_t next_random(uint64_t *state);
+
+void ams_sort(int arr[], size_t size, int groups, int my_rank, int comm_sz) {
+	int *my_arr;
+	size_t count;
+
+	//Distribute partial lists to all processes
+	count = scatter(arr, size, &my_arr, my_rank, comm_sz);
+
+	//Each process sorts partial list
+	serial_qsort(my_arr, count);
+
+	//Partition between groups level by level; groups are contiguous rank ranges, so the
+	//lists end up in rank order
+	count = sort_level(&my_arr, count, (groups < 2) ? 2 : groups, MPI_COMM_WORLD);
+
+	//Gather all partial lists at root
+	gather(my_arr, count, arr, my_rank, comm_sz);
+
+	free(my_arr);
+}
+
+size_t sort_level(int **my_arr, size_t count, int groups, MPI_Comm comm) {
+	ams_splitter *splitters;
+	size_t *bounds;
+	MPI_Comm group_comm;
+	int my_rank, comm_sz, n_buckets;
+
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+	if(comm_sz < 2) {
+		//End of recursion
+		return count;
+	}
+	if(groups > comm_sz) {
+		groups = comm_sz;
+	}
+
+	n_buckets = groups * AMS_OVERPARTITION;
+	splitters = (ams_splitter*)malloc(n_buckets * sizeof(ams_splitter));
+	bounds = (size_t*)malloc((n_buckets + 1) * sizeof(size_t));
+
+	//Split sorted list into buckets, several per group
+	select_splitters(*my_arr, count, splitters, n_buckets, my_rank, comm_sz, comm);
+	bucket(*my_arr, count, splitters, bounds, n_buckets, my_rank);
+
+	//Send every bucket to the members of the group it is assigned to
+	count = exchange(my_arr, bounds, n_buckets, groups, my_rank, comm_sz, comm);
+
+	free(splitters);
+	free(bounds);
+
+	//Recurse inside my group
+	MPI_Comm_split(comm, group_of(my_rank, groups, comm_sz), my_rank, &group_comm);
+	count = sort_level(my_arr, count, groups, group_comm);
+	MPI_Comm_free(&group_comm);
+
+	return count;
+}
+
+void select_splitters(int my_arr[], size_t count, ams_splitter splitters[], int n_buckets,
+	int my_rank, int comm_sz, MPI_Comm comm) {
+	int *sample_counts = (int*)malloc(comm_sz * sizeof(int)),
+		*displs = (int*)malloc(comm_sz * sizeof(int));
+	ams_splitter *samples, *all_samples;
+	MPI_Datatype type = splitter_type();
+	uint64_t state = (my_rank + 1) * 0x9E3779B97F4A7C15ULL ^ count;
+	size_t total;
+	int n_samples = 0, n_all = 0, i;
+
+	//The level draws AMS_OVERSAMPLE samples per group, from each process in proportion
+	//to its list, so the sample stays small however many processes there are
+	MPI_Allreduce(&count, &total, 1, MPI_SIZE_T, MPI_SUM, comm);
+	if(count > 0) {
+		n_samples = (AMS_OVERSAMPLE / AMS_OVERPARTITION * n_buckets * count + total - 1) /
+			total;
+	}
+
+	//Generate local random samples
+	samples = (ams_splitter*)malloc(n_samples * sizeof(ams_splitter));
+	for(i = 0; i < n_samples; ++i) {
+		samples[i].index = next_random(&state) % count;
+		samples[i].key = my_arr[samples[i].index];
+		samples[i].rank = my_rank;
+	}
+
+	//Every process gets the small sample and picks the same splitters, no root involved
+	MPI_Allgather(&n_samples, 1, MPI_INT, sample_counts, 1, MPI_INT, comm);
+	for(i = 0; i < comm_sz; ++i) {
+		displs[i] = n_all;
+		n_all += sample_counts[i];
+	}
+	all_samples = (ams_splitter*)malloc(n_all * sizeof(ams_splitter));
+	MPI_Allgatherv(samples, n_samples, type, all_samples, sample_counts, displs, type, comm);
+
+	qsort(all_samples, n_all, sizeof(ams_splitter), splitter_cmp);
+	for(i = 1; i < n_buckets; ++i) {
+		if(n_all > 0) {
+			splitters[i-1] = all_samples[(size_t)i * n_all / n_buckets];
+		}
+		else {
+			//No data anywhere, any splitter will do
+			splitters[i-1].key = 0;
+			splitters[i-1].rank = 0;
+			splitters[i-1].index = 0;
+		}
+	}
+
+	MPI_Type_free(&type);
+	free(sample_counts);
+	free(displs);
+	free(samples);
+	free(all_samples);
+}
+
+void bucket(int arr[], size_t count, ams_splitter splitters[], size_t bounds[],
+	int n_buckets, int my_rank) {
+	int i;
+
+	bounds[0] = 0;
+	for(i = 1; i < n_buckets; ++i) {
+		ams_splitter *s = &splitters[i-1];
+
+		//Keys equal to the splitter go to the lower bucket up to the sampled element
+		if(my_rank < s->rank) {
+			bounds[i] = upper_bound(arr, count, s->key);
+		}
+		else if(my_rank > s->rank) {
+			bounds[i] = lower_bound(arr, count, s->key);
+		}
+		else {
+			bounds[i] = s->index + 1;
+		}
+
+		if(bounds[i] < bounds[i-1]) {
+			bounds[i] = bounds[i-1];
+		}
+	}
+	bounds[n_buckets] = count;
+}
+
+size_t exchange(int **my_arr, size_t bounds[], int n_buckets, int groups, int my_rank,
+	int comm_sz, MPI_Comm comm) {
+	size_t *bucket_counts = (size_t*)malloc(n_buckets * sizeof(size_t)),
+		*before = (size_t*)calloc(n_buckets, sizeof(size_t)),
+		*totals = (size_t*)malloc(n_buckets * sizeof(size_t)),
+		*run_bounds, received = 0, expected, kept = 0;
+	int *cuts = (int*)malloc((groups + 1) * sizeof(int)),
+		my_group = group_of(my_rank, groups, comm_sz), n_requests = 0, n_pieces = 0,
+		first, members, group, i;
+	int *recv_arr, *scratch, *merged;
+	MPI_Request *requests = (MPI_Request*)malloc(comm_sz * sizeof(MPI_Request));
+	ams_piece *pieces = (ams_piece*)malloc(comm_sz * sizeof(ams_piece));
+
+	for(i = 0; i < n_buckets; ++i) {
+		bucket_counts[i] = bounds[i+1] - bounds[i];
+	}
+
+	//Position of my part of every bucket, and every bucket's size, across the level
+	MPI_Exscan(bucket_counts, before, n_buckets, MPI_SIZE_T, MPI_SUM, comm);
+	if(my_rank == 0) {
+		memset(before, 0, n_buckets * sizeof(size_t));
+	}
+	MPI_Allreduce(bucket_counts, totals, n_buckets, MPI_SIZE_T, MPI_SUM, comm);
+
+	//Every process assigns the same consecutive buckets to each group, then folds them so
+	//entry g describes the part of the level headed for group g
+	assign_buckets(totals, n_buckets, cuts, groups, comm_sz);
+	for(group = 0; group < groups; ++group) {
+		size_t group_before = 0, group_total = 0;
+
+		for(i = cuts[group]; i < cuts[group+1]; ++i) {
+			group_before += before[i];
+			group_total += totals[i];
+		}
+		bucket_counts[group] = bounds[cuts[group+1]] - bounds[cuts[group]];
+		before[group] = group_before;
+		totals[group] = group_total;
+		bounds[group] = bounds[cuts[group]];
+	}
+
+	//Members of a group own equal consecutive ranges of its bucket
+	first = group_start(my_group, groups, comm_sz);
+	members = group_start(my_group + 1, groups, comm_sz) - first;
+	expected = (my_rank - first + 1) * totals[my_group] / members -
+		(my_rank - first) * totals[my_group] / members;
+
+	//Send each part of a bucket only to the members whose range it overlaps
+	for(group = 0; group < groups; ++group) {
+		size_t offset = before[group], count = bucket_counts[group];
+		int member;
+
+		first = group_start(group, groups, comm_sz);
+		members = group_start(group + 1, groups, comm_sz) - first;
+		for(member = 0; (member < members) && (count > 0); ++member) {
+			size_t start = member * totals[group] / members,
+				end = (member + 1) * totals[group] / members;
+
+			start = (start > offset) ? start : offset;
+			end = (end < offset + count) ? end : offset + count;
+			if(end <= start) {
+				continue;
+			}
+
+			if(first + member == my_rank) {
+				kept = bounds[group] + (start - offset);
+				pieces[n_pieces].message = MPI_MESSAGE_NULL;
+				pieces[n_pieces].source = my_rank;
+				pieces[n_pieces++].count = end - start;
+				received += end - start;
+			}
+			else {
+				lc_isend(*my_arr + bounds[group] + (start - offset), end - start, MPI_INT,
+					first + member, AMS_TAG, comm, &requests[n_requests++]);
+			}
+		}
+	}
+
+	//Senders are unknown, so match pieces as they arrive until my range is covered
+	while(received < expected) {
+		MPI_Status status;
+
+		MPI_Mprobe(MPI_ANY_SOURCE, AMS_TAG, comm, &pieces[n_pieces].message, &status);
+		pieces[n_pieces].source = status.MPI_SOURCE;
+		pieces[n_pieces].count = lc_get_count(&status, MPI_INT);
+		received += pieces[n_pieces++].count;
+	}
+
+	//Every piece is a sorted run
+	qsort(pieces, n_pieces, sizeof(ams_piece), piece_cmp);
+	recv_arr = (int*)malloc(expected * sizeof(int));
+	run_bounds = (size_t*)malloc((n_pieces + 1) * sizeof(size_t));
+	received = 0;
+	for(i = 0; i < n_pieces; ++i) {
+		run_bounds[i] = received;
+		if(pieces[i].source == my_rank) {
+			memcpy(recv_arr + received, *my_arr + kept, pieces[i].count * sizeof(int));
+		}
+		else {
+			lc_mrecv(recv_arr + received, pieces[i].count, MPI_INT, &pieces[i].message,
+				MPI_STATUS_IGNORE);
+		}
+		received += pieces[i].count;
+	}
+	run_bounds[n_pieces] = received;
+	MPI_Waitall(n_requests, requests, MPI_STATUSES_IGNORE);
+
+	//Merge all runs into sorted list
+	scratch = (int*)malloc(expected * sizeof(int));
+	merged = merge_runs(recv_arr, scratch, run_bounds, n_pieces);
+
+	free(*my_arr);
+	free((merged == recv_arr) ? scratch : recv_arr);
+	*my_arr = merged;
+
+	free(bucket_counts);
+	free(before);
+	free(totals);
+	free(cuts);
+	free(requests);
+	free(pieces);
+	free(run_bounds);
+
+	return expected;
+}
+
+void assign_buckets(size_t totals[], int n_buckets, int cuts[], int groups, int comm_sz) {
+	size_t total = 0, below = 0;
+	int bucket = 0, group;
+
+	for(group = 0; group < n_buckets; ++group) {
+		total += totals[group];
+	}
+
+	//A group boundary goes after every bucket whose midpoint lies below the group's
+	//share of the level
+	cuts[0] = 0;
+	for(group = 1; group < groups; ++group) {
+		size_t target = (size_t)group_start(group, groups, comm_sz) * total / comm_sz;
+
+		while((bucket < n_buckets) && (below + totals[bucket]/2 < target)) {
+			below += totals[bucket++];
+		}
+		cuts[group] = bucket;
+	}
+	cuts[groups] = n_buckets;
+}
+
+int *merge_runs(int arr[], int scratch[], size_t bounds[], int n_runs) {
+	int *src = arr, *dst = scratch, *tmp;
+
+	//Bottom-up pairwise merges, alternating between the two buffers
+	while(n_runs > 1) {
+		int merged = 0, i;
+
+		for(i = 0; i < n_runs; i += 2) {
+			size_t i_dst = bounds[i], i_a = bounds[i], a_end = bounds[i+1],
+				i_b = a_end, b_end = (i + 1 < n_runs) ? bounds[i+2] : a_end;
+
+			while((i_a < a_end) && (i_b < b_end)) {
+				dst[i_dst++] = (src[i_b] < src[i_a]) ? src[i_b++] : src[i_a++];
+			}
+			memcpy(dst + i_dst, src + i_a, (a_end - i_a) * sizeof(int));
+			i_dst += a_end - i_a;
+			memcpy(dst + i_dst, src + i_b, (b_end - i_b) * sizeof(int));
+
+			bounds[merged++] = bounds[i];
+		}
+		bounds[merged] = bounds[n_runs];
+		n_runs = merged;
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	return src;
+}
+
+size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz) {
+	size_t count;
+
+	if(my_rank == 0) {
+		//Send array chunks to other processes
+		int i;
+		for(i = 1; i < comm_sz; ++i) {
+			size_t start = i*size/comm_sz,
+				end = (i+1)*size/comm_sz;
+
+			lc_send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
+		}
+
+		count = size/comm_sz;
+		*my_arr = (int*)malloc(count * sizeof(int));
+		memcpy(*my_arr, arr, count * sizeof(int));
+	}
+	else {
+		//Receive array chunk from master
+		MPI_Status status;
+		MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+		count = lc_get_count(&status, MPI_INT);
+
+		*my_arr = (int*)malloc(count * sizeof(int));
+		lc_recv(*my_arr, count, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	return count;
+}
+
+void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz) {
+	size_t *recv_counts = NULL, *displacements = NULL;
+
+	if(my_rank == 0) {
+		recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displacements = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&count, 1, MPI_SIZE_T, recv_counts, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		int i;
+		displacements[0] = 0;
+		for(i = 1; i < comm_sz; ++i) {
+			displacements[i] = displacements[i-1] + recv_counts[i-1];
+		}
+	}
+	lc_gatherv(my_arr, count, arr, recv_counts, displacements, MPI_INT, 0, MPI_COMM_WORLD);
+
+	free(recv_counts);
+	free(displacements);
+}
+
+int group_start(int group, int groups, int comm_sz) {
+	return (int)((long)group * comm_sz / groups);
+}
+
+int group_of(int rank, int groups, int comm_sz) {
+	int group = (int)((long)rank * groups / comm_sz);
+
+	while(group_start(group + 1, groups, comm_sz) <= rank) {
+		group++;
+	}
+	while(group_start(group, groups, comm_sz) > rank) {
+		group--;
+	}
+
+	return group;
+}
+
+size_t lower_bound(int arr[], size_t count, int key) {
+	size_t low = 0, high = count;
+
+	while(low < high) {
+		size_t middle = low + (high - low)/2;
+
+		if(arr[middle] < key) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+size_t upper_bound(int arr[], size_t count, int key) {
+	size_t low = 0, high = count;
+
+	while(low < high) {
+		size_t middle = low + (high - low)/2;
+
+		if(arr[middle] <= key) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+MPI_Datatype splitter_type(void) {
+	int lengths[3] = {1, 1, 1};
+	MPI_Aint displs[3] = {offsetof(ams_splitter, key), offsetof(ams_splitter, rank),
+		offsetof(ams_splitter, index)};
+	MPI_Datatype types[3] = {MPI_INT, MPI_INT, MPI_SIZE_T}, struct_type, type;
+
+	MPI_Type_create_struct(3, lengths, displs, types, &struct_type);
+	MPI_Type_create_resized(struct_type, 0, sizeof(ams_splitter), &type);
+	MPI_Type_commit(&type);
+	MPI_Type_free(&struct_type);
+
+	return type;
+}
+
+int splitter_cmp(const void *a, const void *b) {
+	const ams_splitter *x = (const ams_splitter*)a, *y = (const ams_splitter*)b;
+
+	if(x->key != y->key) {
+		return (x->key > y->key) - (x->key < y->key);
+	}
+	if(x->rank != y->rank) {
+		return x->rank - y->rank;
+	}
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+int piece_cmp(const void *a, const void *b) {
+	return ((const ams_piece*)a)->source - ((const ams_piece*)b)->source;
+}
+
+uint64_t next_random(uint64_t *state) {
+	//xorshift64*, independent of rand() which callers may use to generate their input
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+
+	return *state * 0x2545F4914F6CDD1DULL;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+//Multi-level sample sort for large process counts. Each level splits the processes into
+//groups contiguous groups, partitions the data between the groups with splitters drawn
+//from a small distributed sample, and recurses inside every group on its own
+//communicator. A process exchanges with O(groups) peers per level instead of all of
+//them, and no process ever holds more than a few samples per group.
+void ams_sort(int arr[], size_t size, int groups, int my_rank, int comm_sz);
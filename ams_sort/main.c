@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h> 
+
+#include "ams_sort.h"
+#include "serial_qsort.h"
+
+#define ARRAY_SIZE		1024
+#define GROUPS			2
+
+void print_array(int* arr, size_t size);
+
+int main(void) {
+   int my_rank, comm_sz;
+
+   MPI_Init(NULL, NULL); 
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
+
+	int* arr;
+	if(my_rank == 0) {
+		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+	
+	ams_sort(arr, ARRAY_SIZE, GROUPS, my_rank, comm_sz);
+	
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Validation successful!\n");
+		}
+		else {
+			printf("[Error] Validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+
+		free(arr);
+	}
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+void print_array(int* arr, size_t size) {
+	printf("\t");
+	int i;
+	for(i = 0; i < size; ++i) {
+		printf("%d ", arr[i]);
+	}
+	printf("\n");
+}
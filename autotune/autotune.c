@@ -0,0 +1,478 @@
+#include "autotune.h"
+#include "serial_qsort.h"
+
+#include "psrs.h"
+#include "presort.h"
+#include "hyper_qsort.h"
+#include "merge_sort.h"
+#include "binary_sort.h"
+#include "histogram_sort.h"
+#include "bitonic_sort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+
+#define CALIBRATE_SIZE		(1 << 16)
+#define CALIBRATE_REPEAT	100
+#define INPUT_SAMPLE_SIZE	1024
+
+#define HISTOGRAM_EPSILON	0.05
+#define HISTOGRAM_MIN_SAMPLES	4
+#define HISTOGRAM_MAX_SAMPLES	256
+
+//Per chunk latency is kept below this fraction of the chunk's transfer time
+#define CHUNK_OVERHEAD		0.1
+#define MIN_CHUNK_SIZE		1024
+
+//Cheap look at the input taken from root's samples
+typedef struct {
+	double disorder;		//Fraction of repeated keys
+	double presorted;		//Fraction of ascending neighbouring samples
+	int descents;			//Descending neighbouring samples
+} input_shape;
+
+static void ping_pong(int partner, int my_rank, int send[], int recv[], double *latency_us,
+	double *byte_ns);
+static double sort_cost(const tune_profile *profile, double count, double disorder);
+static double local_cost(const tune_profile *profile, double count, const input_shape *shape,
+	int presort, int comm_sz);
+static double exchange_cost(const tune_profile *profile, double count, int comm_sz);
+static double histogram_cost(const tune_profile *profile, double size, int samples,
+	int comm_sz);
+static double cost(const tune_profile *profile, tune_engine engine, double size,
+	const input_shape *shape, const tune_choice *knobs, int comm_sz);
+static int tune_samples(const tune_profile *profile, size_t size, int comm_sz);
+static int tune_presort(const tune_profile *profile, size_t size, const input_shape *shape,
+	int comm_sz);
+static size_t tune_chunk(const tune_profile *profile, size_t size, int comm_sz);
+static int hcube_size(int comm_sz);
+static int cmp_int(const void *a, const void *b);
+
+static const char *engine_names[ENGINE_COUNT] = {
+	"psrs", "hyper_qsort", "merge_sort", "binary_sort", "histogram_sort", "bitonic_sort"
+};
+
+void tune_calibrate(tune_profile *profile, int my_rank, int comm_sz) {
+	int *arr = (int*)malloc(2 * CALIBRATE_SIZE * sizeof(int)),
+		*out = (int*)malloc(2 * CALIBRATE_SIZE * sizeof(int));
+	double start, local[3], worst[3];
+	int i, value = 0, sum, node_leader, candidates[2], partners[2];
+	volatile int descents = 0;
+	MPI_Comm node_comm;
+
+	//Local sort rate on random keys
+	for(i = 0; i < CALIBRATE_SIZE; ++i) {
+		arr[i] = rand();
+	}
+	start = MPI_Wtime();
+	for(i = 1; i < CALIBRATE_SIZE; ++i) {
+		descents += arr[i] < arr[i-1];
+	}
+	local[2] = (MPI_Wtime() - start) * 1e9 / CALIBRATE_SIZE;
+
+	start = MPI_Wtime();
+	serial_qsort(arr, CALIBRATE_SIZE);
+	local[0] = (MPI_Wtime() - start) * 1e9 / (CALIBRATE_SIZE * log2(CALIBRATE_SIZE));
+
+	//Merge bandwidth of two sorted runs
+	for(i = 0; i < CALIBRATE_SIZE; ++i) {
+		arr[CALIBRATE_SIZE + i] = arr[i] + 1;
+	}
+	start = MPI_Wtime();
+	{
+		int i_a = 0, i_b = CALIBRATE_SIZE, i_out = 0;
+		while((i_a < CALIBRATE_SIZE) && (i_b < 2 * CALIBRATE_SIZE)) {
+			out[i_out++] = (arr[i_a] <= arr[i_b]) ? arr[i_a++] : arr[i_b++];
+		}
+		while(i_a < CALIBRATE_SIZE) {
+			out[i_out++] = arr[i_a++];
+		}
+		while(i_b < 2 * CALIBRATE_SIZE) {
+			out[i_out++] = arr[i_b++];
+		}
+	}
+	local[1] = (MPI_Wtime() - start) * 1e9 / (2 * CALIBRATE_SIZE);
+
+	//The slowest process sets the pace
+	MPI_Allreduce(local, worst, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	profile->comm_sz = comm_sz;
+	profile->sort_ns = worst[0];
+	profile->merge_ns = worst[1];
+	profile->scan_ns = worst[2];
+
+	//Ping-pong from root to the next process on its node and to the first process on
+	//another node, so exchanges crossing the node boundary are costed as well
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL,
+		&node_comm);
+	MPI_Comm_size(node_comm, &profile->node_sz);
+	MPI_Allreduce(&my_rank, &node_leader, 1, MPI_INT, MPI_MIN, node_comm);
+	MPI_Comm_free(&node_comm);
+
+	candidates[0] = ((node_leader == 0) && (my_rank != 0)) ? my_rank : INT_MAX;
+	candidates[1] = (node_leader != 0) ? my_rank : INT_MAX;
+	MPI_Allreduce(candidates, partners, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+	ping_pong(partners[0], my_rank, arr, out, &profile->latency_us, &profile->byte_ns);
+	if(partners[1] != INT_MAX) {
+		ping_pong(partners[1], my_rank, arr, out, &profile->remote_latency_us,
+			&profile->remote_byte_ns);
+	}
+	else {
+		profile->remote_latency_us = profile->latency_us;
+		profile->remote_byte_ns = profile->byte_ns;
+	}
+
+	//Small collective latency
+	MPI_Barrier(MPI_COMM_WORLD);
+	start = MPI_Wtime();
+	for(i = 0; i < CALIBRATE_REPEAT; ++i) {
+		MPI_Allreduce(&value, &sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	}
+	profile->coll_us = (MPI_Wtime() - start) * 1e6 / CALIBRATE_REPEAT;
+
+	//Everyone uses root's view of the communication costs
+	MPI_Bcast(profile, sizeof(tune_profile), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	free(arr);
+	free(out);
+}
+
+int tune_save(const tune_profile *profile, const char *path) {
+	FILE *file = fopen(path, "w");
+
+	if(file == NULL) {
+		return 0;
+	}
+
+	fprintf(file, "comm_sz %d\n", profile->comm_sz);
+	fprintf(file, "node_sz %d\n", profile->node_sz);
+	fprintf(file, "sort_ns %g\n", profile->sort_ns);
+	fprintf(file, "merge_ns %g\n", profile->merge_ns);
+	fprintf(file, "scan_ns %g\n", profile->scan_ns);
+	fprintf(file, "latency_us %g\n", profile->latency_us);
+	fprintf(file, "byte_ns %g\n", profile->byte_ns);
+	fprintf(file, "remote_latency_us %g\n", profile->remote_latency_us);
+	fprintf(file, "remote_byte_ns %g\n", profile->remote_byte_ns);
+	fprintf(file, "coll_us %g\n", profile->coll_us);
+	fclose(file);
+
+	return 1;
+}
+
+int tune_load(tune_profile *profile, const char *path, int my_rank, int comm_sz) {
+	int valid = 0;
+
+	if(my_rank == 0) {
+		FILE *file = fopen(path, "r");
+
+		if(file != NULL) {
+			valid = fscanf(file, "comm_sz %d node_sz %d sort_ns %lf merge_ns %lf scan_ns %lf "
+				"latency_us %lf byte_ns %lf remote_latency_us %lf remote_byte_ns %lf "
+				"coll_us %lf", &profile->comm_sz, &profile->node_sz, &profile->sort_ns,
+				&profile->merge_ns, &profile->scan_ns, &profile->latency_us, &profile->byte_ns,
+				&profile->remote_latency_us, &profile->remote_byte_ns,
+				&profile->coll_us) == 10;
+			valid = valid && (profile->comm_sz == comm_sz);
+			fclose(file);
+		}
+	}
+
+	MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if(valid) {
+		MPI_Bcast(profile, sizeof(tune_profile), MPI_BYTE, 0, MPI_COMM_WORLD);
+	}
+
+	return valid;
+}
+
+tune_choice tune_select(const tune_profile *profile, int arr[], size_t size, int my_rank,
+	int comm_sz) {
+	tune_choice choice;
+
+	if(my_rank == 0) {
+		int samples[INPUT_SAMPLE_SIZE], sorted[INPUT_SAMPLE_SIZE];
+		int n_samples = (size < INPUT_SAMPLE_SIZE) ? size : INPUT_SAMPLE_SIZE;
+		int i, ascending = 0, distinct = (n_samples > 0);
+		input_shape shape = {0, 1, 0};
+		tune_engine engine;
+
+		//Cheap look at the input: how ordered it is and how many keys repeat
+		for(i = 0; i < n_samples; ++i) {
+			samples[i] = arr[(size_t)i*size/n_samples];
+			sorted[i] = samples[i];
+		}
+		qsort(sorted, n_samples, sizeof(int), cmp_int);
+		for(i = 1; i < n_samples; ++i) {
+			ascending += samples[i-1] <= samples[i];
+			shape.descents += samples[i-1] > samples[i];
+			distinct += sorted[i-1] != sorted[i];
+		}
+		if(n_samples > 1) {
+			shape.presorted = (double)ascending / (n_samples - 1);
+		}
+		if(n_samples > 0) {
+			shape.disorder = 1.0 - (double)distinct / n_samples;
+		}
+
+		//Knobs first, since the engine costs depend on them
+		choice.sample_size = tune_samples(profile, size, comm_sz);
+		choice.epsilon = HISTOGRAM_EPSILON;
+		choice.presort = tune_presort(profile, size, &shape, comm_sz);
+		choice.chunk_size = tune_chunk(profile, size, comm_sz);
+
+		choice.engine = ENGINE_PSRS;
+		choice.cost_us = cost(profile, ENGINE_PSRS, size, &shape, &choice, comm_sz);
+		for(engine = 0; engine < ENGINE_COUNT; ++engine) {
+			double engine_cost = cost(profile, engine, size, &shape, &choice, comm_sz);
+
+			if(engine_cost < choice.cost_us) {
+				choice.engine = engine;
+				choice.cost_us = engine_cost;
+			}
+		}
+		if((choice.engine != ENGINE_PSRS) && (choice.engine != ENGINE_HYPER_QSORT)) {
+			choice.presort = 0;
+		}
+	}
+
+	MPI_Bcast(&choice, sizeof(tune_choice), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	return choice;
+}
+
+tune_choice tune_sort(const tune_profile *profile, int arr[], size_t size, int my_rank,
+	int comm_sz) {
+	tune_choice choice = tune_select(profile, arr, size, my_rank, comm_sz);
+	int presort = presort_enabled();
+
+	presort_enable(choice.presort);
+	switch(choice.engine) {
+		case ENGINE_HYPER_QSORT:
+			hyper_qsort(arr, size, my_rank, comm_sz);
+			break;
+		case ENGINE_MERGE_SORT:
+			merge_sort(arr, size, my_rank, comm_sz);
+			break;
+		case ENGINE_BINARY_SORT:
+			binary_sort(arr, size, my_rank, comm_sz);
+			break;
+		case ENGINE_HISTOGRAM_SORT:
+			histogram_sort(arr, size, choice.epsilon, choice.sample_size, my_rank, comm_sz);
+			break;
+		case ENGINE_BITONIC_SORT:
+			bitonic_sort(arr, size, my_rank, comm_sz);
+			break;
+		default:
+			psrs(arr, size, my_rank, comm_sz);
+			break;
+	}
+	presort_enable(presort);
+
+	return choice;
+}
+
+const char* tune_engine_name(tune_engine engine) {
+	return engine_names[engine];
+}
+
+void ping_pong(int partner, int my_rank, int send[], int recv[], double *latency_us,
+	double *byte_ns) {
+	int sizes[2] = {1, CALIBRATE_SIZE}, i, j;
+	double times[2], start;
+
+	*latency_us = 0;
+	*byte_ns = 0;
+	if(partner == INT_MAX) {
+		return;
+	}
+
+	for(j = 0; j < 2; ++j) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		start = MPI_Wtime();
+		for(i = 0; i < CALIBRATE_REPEAT; ++i) {
+			if(my_rank == 0) {
+				MPI_Send(send, sizes[j], MPI_INT, partner, 0, MPI_COMM_WORLD);
+				MPI_Recv(recv, sizes[j], MPI_INT, partner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			}
+			else if(my_rank == partner) {
+				MPI_Recv(recv, sizes[j], MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				MPI_Send(send, sizes[j], MPI_INT, 0, 0, MPI_COMM_WORLD);
+			}
+		}
+		times[j] = (MPI_Wtime() - start) / (2 * CALIBRATE_REPEAT);
+	}
+
+	*latency_us = times[0] * 1e6;
+	*byte_ns = (times[1] - times[0]) * 1e9 / (CALIBRATE_SIZE * sizeof(int));
+	if(*byte_ns < 0) {
+		*byte_ns = 0;
+	}
+}
+
+double sort_cost(const tune_profile *profile, double count, double disorder) {
+	//serial_qsort degrades towards quadratic on repeated keys and sorted runs
+	double n_log_n = count * log2(count + 1), quadratic = count * count / 2;
+
+	return profile->sort_ns * ((1 - disorder) * n_log_n + disorder * quadratic) * 1e-3;
+}
+
+double local_cost(const tune_profile *profile, double count, const input_shape *shape,
+	int presort, int comm_sz) {
+	//Extreme ordering in either direction hits the quicksort worst case
+	double degenerate = fmax(shape->disorder, fabs(2 * shape->presorted - 1));
+	//Every process sees its share of the sampled descents, at least
+	double runs = 1 + (double)shape->descents / comm_sz;
+
+	if(!presort) {
+		return sort_cost(profile, count, degenerate);
+	}
+
+	//The presort pass scans once, then keeps, reverses or merges runs, or falls back
+	if(shape->descents == 0) {
+		return profile->scan_ns * count * 1e-3 + profile->coll_us;
+	}
+	if(shape->presorted == 0) {
+		return 2 * profile->scan_ns * count * 1e-3 + profile->coll_us;
+	}
+	if(runs <= PRESORT_MAX_RUNS) {
+		return profile->scan_ns * count * 1e-3 + profile->coll_us +
+			profile->merge_ns * count * ceil(log2(runs)) * 1e-3;
+	}
+	return profile->scan_ns * count * 1e-3 + profile->coll_us +
+		sort_cost(profile, count, shape->disorder);
+}
+
+double exchange_cost(const tune_profile *profile, double count, int comm_sz) {
+	//Share of the peers that sit on another node
+	double remote = (comm_sz > 1) ? (double)(comm_sz - profile->node_sz) / (comm_sz - 1) : 0;
+
+	return (1 - remote) * (profile->latency_us + count * sizeof(int) * profile->byte_ns * 1e-3) +
+		remote * (profile->remote_latency_us +
+		count * sizeof(int) * profile->remote_byte_ns * 1e-3);
+}
+
+double histogram_cost(const tune_profile *profile, double size, int samples, int comm_sz) {
+	double local = size / comm_sz, all_samples = (double)samples * comm_sz;
+	//Regular samples leave a splitter about local/samples positions off its target and
+	//every refinement round halves that until it is within epsilon*local/2
+	double rounds = 1 + fmax(0, ceil(log2(2.0 / (samples * HISTOGRAM_EPSILON))));
+
+	return profile->coll_us + comm_sz * exchange_cost(profile, samples, comm_sz) / 2 +
+		sort_cost(profile, all_samples, 0) +
+		rounds * (profile->coll_us + comm_sz * profile->sort_ns * log2(local + 1) * 1e-3);
+}
+
+double cost(const tune_profile *profile, tune_engine engine, double size,
+	const input_shape *shape, const tune_choice *knobs, int comm_sz) {
+	double local = size / comm_sz, levels = log2(comm_sz);
+	double degenerate = fmax(shape->disorder, fabs(2 * shape->presorted - 1));
+	//Root scatters the input and gathers the result in every engine
+	double root = 2 * (comm_sz - 1) * exchange_cost(profile, local, comm_sz);
+	//Presort skips the redistribution when the lists are already in rank order
+	double redistribute = (knobs->presort && (shape->descents == 0)) ? 0 : 1;
+
+	switch(engine) {
+		case ENGINE_PSRS:
+			//Sample gather, pivot broadcast, all-to-all and a comm_sz-way linear-scan merge
+			return root + local_cost(profile, local, shape, knobs->presort, comm_sz) +
+				redistribute * (3 * levels * profile->coll_us +
+				comm_sz * exchange_cost(profile, local / comm_sz, comm_sz) +
+				profile->merge_ns * local * comm_sz * 1e-3);
+		case ENGINE_HYPER_QSORT:
+			//One partner exchange and merge per cube dimension
+			return root + local_cost(profile, local, shape, knobs->presort, comm_sz) +
+				redistribute * ceil(levels) * (profile->latency_us +
+				exchange_cost(profile, local / 2, comm_sz) + profile->merge_ns * local * 1e-3);
+		case ENGINE_MERGE_SORT:
+			//Halves travel down and back up the process tree and root merges everything
+			return sort_cost(profile, local, degenerate) +
+				2 * ceil(levels) * exchange_cost(profile, size / 2, comm_sz) +
+				profile->merge_ns * size * ceil(levels) * 1e-3;
+		case ENGINE_BINARY_SORT:
+			//Binary insertion only moves memory for keys arriving out of order
+			return profile->sort_ns * local * log2(local + 1) * 1e-3 +
+				profile->merge_ns * local * local / 4 * (1 - shape->presorted) * 1e-3 +
+				2 * ceil(levels) * exchange_cost(profile, size / 2, comm_sz) +
+				profile->merge_ns * size * ceil(levels) * 1e-3;
+		case ENGINE_HISTOGRAM_SORT:
+			return root + sort_cost(profile, local, degenerate) +
+				histogram_cost(profile, size, knobs->sample_size, comm_sz) +
+				comm_sz * exchange_cost(profile, local / comm_sz, comm_sz) +
+				profile->merge_ns * local * comm_sz * 1e-3;
+		case ENGINE_BITONIC_SORT: {
+			//Only a power of two subset sorts, in levels*(levels+1)/2 compare-splits
+			int cube_sz = hcube_size(comm_sz);
+			double block = ceil(size / cube_sz), steps = log2(cube_sz) * (log2(cube_sz) + 1) / 2;
+
+			return 2 * (cube_sz - 1) * exchange_cost(profile, block, comm_sz) +
+				sort_cost(profile, block, degenerate) +
+				steps * (exchange_cost(profile, block, comm_sz) + profile->merge_ns * block * 1e-3);
+		}
+		default:
+			return HUGE_VAL;
+	}
+}
+
+int tune_samples(const tune_profile *profile, size_t size, int comm_sz) {
+	//More samples cost a larger allgather and sort but save refinement rounds
+	int samples, best = HISTOGRAM_MIN_SAMPLES;
+	double best_cost = HUGE_VAL;
+
+	for(samples = HISTOGRAM_MIN_SAMPLES; samples <= HISTOGRAM_MAX_SAMPLES; samples *= 2) {
+		double samples_cost = histogram_cost(profile, size, samples, comm_sz);
+
+		if(samples_cost < best_cost) {
+			best = samples;
+			best_cost = samples_cost;
+		}
+	}
+
+	return best;
+}
+
+int tune_presort(const tune_profile *profile, size_t size, const input_shape *shape,
+	int comm_sz) {
+	double local = (double)size / comm_sz;
+
+	return local_cost(profile, local, shape, 1, comm_sz) <
+		local_cost(profile, local, shape, 0, comm_sz);
+}
+
+size_t tune_chunk(const tune_profile *profile, size_t size, int comm_sz) {
+	//A chunk costs a request and its transfer; large enough chunks hide the round trip
+	double latency_us = 2 * profile->remote_latency_us,
+		element_us = sizeof(int) * profile->remote_byte_ns * 1e-3;
+	size_t chunk = MIN_CHUNK_SIZE, local = size / comm_sz;
+
+	if(element_us > 0) {
+		chunk = (size_t)(latency_us / (CHUNK_OVERHEAD * element_us));
+	}
+	else if(latency_us > 0) {
+		chunk = local;
+	}
+
+	if(chunk > local) {
+		chunk = local;
+	}
+
+	return (chunk < MIN_CHUNK_SIZE) ? MIN_CHUNK_SIZE : chunk;
+}
+
+int hcube_size(int comm_sz) {
+	int size = 1;
+
+	while((size << 1) <= comm_sz) {
+		size <<= 1;
+	}
+
+	return size;
+}
+
+int cmp_int(const void *a, const void *b) {
+	int x = *(const int*)a, y = *(const int*)b;
+
+	return (x > y) - (x < y);
+}
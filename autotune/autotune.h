@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+
+//Machine costs measured by a calibration run on the current allocation
+typedef struct {
+	int comm_sz;
+	int node_sz;				//Processes sharing root's node
+	double sort_ns;				//serial_qsort cost per element and per log2(elements)
+	double merge_ns;			//Two-way merge cost per output element
+	double scan_ns;				//Presort pass cost per element
+	double latency_us;			//Point-to-point one-way latency within root's node
+	double byte_ns;				//Point-to-point cost per byte within root's node
+	double remote_latency_us;	//Same across the node boundary, equal to the above on one node
+	double remote_byte_ns;
+	double coll_us;				//Small MPI_Allreduce latency
+} tune_profile;
+
+typedef enum {
+	ENGINE_PSRS,
+	ENGINE_HYPER_QSORT,
+	ENGINE_MERGE_SORT,
+	ENGINE_BINARY_SORT,
+	ENGINE_HISTOGRAM_SORT,
+	ENGINE_BITONIC_SORT,
+	ENGINE_COUNT
+} tune_engine;
+
+//Engine and knobs picked for one sort call
+typedef struct {
+	tune_engine engine;
+	int sample_size;		//Histogram sort samples per process, cheapest predicted
+	double epsilon;			//Histogram sort load balance tolerance, a fixed target
+	int presort;			//Local kernel of psrs and hyper_qsort: presort pass or qsort
+	size_t chunk_size;		//Stream sink chunk for callers streaming the output
+	double cost_us;			//Predicted time
+} tune_choice;
+
+void tune_calibrate(tune_profile *profile, int my_rank, int comm_sz);
+
+//Profiles are read and written by root only; tune_load broadcasts the result and
+//returns 0 if the file is missing or was calibrated for another comm_sz
+int tune_save(const tune_profile *profile, const char *path);
+int tune_load(tune_profile *profile, const char *path, int my_rank, int comm_sz);
+
+//Root samples arr to pick the engine and its knobs and broadcasts the choice.
+//tune_sort() applies the local kernel itself; chunk_size is meant for stream_sink_enable()
+tune_choice tune_select(const tune_profile *profile, int arr[], size_t size, int my_rank,
+	int comm_sz);
+tune_choice tune_sort(const tune_profile *profile, int arr[], size_t size, int my_rank,
+	int comm_sz);
+
+const char* tune_engine_name(tune_engine engine);
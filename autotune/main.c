@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h> 
+
+#include "autotune.h"
+
+#define ARRAY_SIZE		1024
+#define PROFILE_PATH	"autotune.profile"
+
+void print_array(int* arr, size_t size);
+int validate(int* arr, size_t size);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz;
+	tune_profile profile;
+
+   MPI_Init(NULL, NULL); 
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
+
+	//Usage: tune [calibrate]
+	if(((argc > 1) && (strcmp(argv[1], "calibrate") == 0)) ||
+		!tune_load(&profile, PROFILE_PATH, my_rank, comm_sz)) {
+		tune_calibrate(&profile, my_rank, comm_sz);
+
+		if(my_rank == 0) {
+			if(tune_save(&profile, PROFILE_PATH)) {
+				printf("[Info] Calibrated %d processes (%d on root's node): sort %.2f ns, "
+					"merge %.2f ns, scan %.2f ns, latency %.2f us, %.3f ns/byte, "
+					"remote latency %.2f us, %.3f ns/byte, allreduce %.2f us\n", comm_sz,
+					profile.node_sz, profile.sort_ns, profile.merge_ns, profile.scan_ns,
+					profile.latency_us, profile.byte_ns, profile.remote_latency_us,
+					profile.remote_byte_ns, profile.coll_us);
+			}
+			else {
+				printf("[Error] Could not write %s\n", PROFILE_PATH);
+			}
+		}
+	}
+
+	int* arr;
+	if(my_rank == 0) {
+		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+
+	tune_choice choice = tune_sort(&profile, arr, ARRAY_SIZE, my_rank, comm_sz);
+	
+	if(my_rank == 0) {
+		printf("[Info] Sorted with %s (predicted %.1f us): %d samples, presort %s, "
+			"chunk %zu\n", tune_engine_name(choice.engine), choice.cost_us, choice.sample_size,
+			choice.presort ? "on" : "off", choice.chunk_size);
+
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Validation successful!\n");
+		}
+		else {
+			printf("[Error] Validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+
+		free(arr);
+	}
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+void print_array(int* arr, size_t size) {
+	printf("\t");
+	int i;
+	for(i = 0; i < size; ++i) {
+		printf("%d ", arr[i]);
+	}
+	printf("\n");
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "kernels.h"
+#include "perf_counters.h"
+
+#define MIN_SIZE		1024
+#define MAX_SIZE		(1 << 23)
+#define SIZE_STEP		4
+#define MIN_BENCH_NS	20e6
+#define PSRS_LISTS		8
+
+typedef enum {
+	DIST_RANDOM,
+	DIST_SORTED,
+	DIST_REVERSED,
+	DIST_FEW_UNIQUE,
+	DIST_COUNT
+} distribution;
+
+//Inputs prepared once per size and distribution; kernels only read these
+typedef struct {
+	size_t size;
+	int *input;				//Raw distribution
+	int *sorted;			//Fully sorted input
+	int *halves;			//Input with each half sorted
+	int *runs;				//Input with each of PSRS_LISTS chunks sorted
+	int *mask;
+	int *work, *scratch, *out;
+	int *sublists[PSRS_LISTS];
+	size_t list_counts[PSRS_LISTS];
+} bench_state;
+
+typedef struct {
+	const char *name;
+	void (*setup)(bench_state *state);		//Untimed, restores clobbered buffers
+	void (*run)(bench_state *state);		//Timed, processes state->size elements
+} kernel;
+
+static void generate(bench_state *state, distribution dist);
+static void sort_chunks(int arr[], const int input[], size_t size, int chunks);
+static void measure(const kernel *kern, bench_state *state, const char *dist_name,
+	perf_counters *counters);
+static double now_ns(void);
+static int cmp_int(const void *a, const void *b);
+
+static void setup_none(bench_state *state) {
+}
+
+static void setup_copy_input(bench_state *state) {
+	memcpy(state->work, state->input, state->size * sizeof(int));
+}
+
+static void setup_copy_half(bench_state *state) {
+	memcpy(state->work, state->halves, state->size/2 * sizeof(int));
+}
+
+static void run_qsort_partition(bench_state *state) {
+	kernel_qsort_partition(state->work, state->size);
+}
+
+static void run_psrs_partition(bench_state *state) {
+	//Pivot is the largest key, so the scan covers the whole list
+	kernel_psrs_partition(state->sorted, state->size, state->sorted[state->size-1]);
+}
+
+static void run_psrs_merge(bench_state *state) {
+	kernel_psrs_merge(state->out, state->sublists, state->list_counts, PSRS_LISTS);
+}
+
+static void run_min_index(bench_state *state) {
+	kernel_min_index(state->input, state->mask, state->size);
+}
+
+static void run_hqs_merge(bench_state *state) {
+	kernel_hqs_merge(state->work, 0, state->size/2, state->halves + state->size/2,
+		state->size - state->size/2, state->scratch);
+}
+
+static void run_merge_sort_merge(bench_state *state) {
+	kernel_merge_sort_merge(state->work, state->size/2, state->halves + state->size/2,
+		state->size - state->size/2, state->scratch);
+}
+
+static void run_binary_sort_merge(bench_state *state) {
+	kernel_binary_sort_merge(state->work, state->size/2, state->halves + state->size/2,
+		state->size - state->size/2, state->scratch);
+}
+
+static void run_binary_search(bench_state *state) {
+	size_t i;
+
+	for(i = 0; i < state->size; ++i) {
+		kernel_binary_search(state->sorted, state->size, state->input[i]);
+	}
+}
+
+static const kernel kernels[] = {
+	{"qsort_partition", setup_copy_input, run_qsort_partition},
+	{"psrs_partition", setup_none, run_psrs_partition},
+	{"psrs_merge", setup_none, run_psrs_merge},
+	{"min_index", setup_none, run_min_index},
+	{"hqs_merge", setup_copy_half, run_hqs_merge},
+	{"merge_sort_merge", setup_copy_half, run_merge_sort_merge},
+	{"binary_sort_merge", setup_copy_half, run_binary_sort_merge},
+	{"binary_search", setup_none, run_binary_search}
+};
+
+static const char *dist_names[DIST_COUNT] = {"random", "sorted", "reversed", "few_unique"};
+
+int main(int argc, char* argv[]) {
+	//Usage: bench [max_elements]
+	size_t max_size = (argc > 1) ? strtoul(argv[1], NULL, 10) : MAX_SIZE, size;
+	perf_counters counters;
+	bench_state state;
+	int dist, k, i;
+
+	if(max_size < MIN_SIZE) {
+		max_size = MIN_SIZE;
+	}
+
+	state.input = (int*)malloc(max_size * sizeof(int));
+	state.sorted = (int*)malloc(max_size * sizeof(int));
+	state.halves = (int*)malloc(max_size * sizeof(int));
+	state.runs = (int*)malloc(max_size * sizeof(int));
+	state.mask = (int*)malloc(max_size * sizeof(int));
+	state.work = (int*)malloc(max_size * sizeof(int));
+	state.scratch = (int*)malloc(max_size * sizeof(int));
+	state.out = (int*)malloc(max_size * sizeof(int));
+	for(i = 0; i < max_size; ++i) {
+		state.mask[i] = 1;
+	}
+
+	perf_open(&counters);
+
+	printf("kernel,distribution,elements,bytes,repetitions,ns_per_element,"
+		"cycles_per_element,instructions_per_element,branch_misses_per_element,"
+		"llc_misses_per_element\n");
+
+	for(size = MIN_SIZE; size <= max_size; size *= SIZE_STEP) {
+		for(dist = 0; dist < DIST_COUNT; ++dist) {
+			state.size = size;
+			generate(&state, dist);
+
+			for(k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+				measure(&kernels[k], &state, dist_names[dist], &counters);
+			}
+		}
+	}
+
+	perf_close(&counters);
+
+	free(state.input);
+	free(state.sorted);
+	free(state.halves);
+	free(state.runs);
+	free(state.mask);
+	free(state.work);
+	free(state.scratch);
+	free(state.out);
+
+	return 0;
+}
+
+void generate(bench_state *state, distribution dist) {
+	size_t i, size = state->size;
+
+	srand(1);
+	for(i = 0; i < size; ++i) {
+		switch(dist) {
+			case DIST_SORTED:
+				state->input[i] = i;
+				break;
+			case DIST_REVERSED:
+				state->input[i] = size - i;
+				break;
+			case DIST_FEW_UNIQUE:
+				state->input[i] = rand() % 100;
+				break;
+			default:
+				state->input[i] = rand();
+				break;
+		}
+	}
+
+	sort_chunks(state->sorted, state->input, size, 1);
+	sort_chunks(state->halves, state->input, size, 2);
+	sort_chunks(state->runs, state->input, size, PSRS_LISTS);
+
+	for(i = 0; i < PSRS_LISTS; ++i) {
+		size_t start = i*size/PSRS_LISTS, end = (i+1)*size/PSRS_LISTS;
+
+		state->sublists[i] = state->runs + start;
+		state->list_counts[i] = end - start;
+	}
+}
+
+void sort_chunks(int arr[], const int input[], size_t size, int chunks) {
+	int i;
+
+	memcpy(arr, input, size * sizeof(int));
+	for(i = 0; i < chunks; ++i) {
+		size_t start = i*size/chunks, end = (i+1)*size/chunks;
+
+		qsort(arr + start, end - start, sizeof(int), cmp_int);
+	}
+}
+
+void measure(const kernel *kern, bench_state *state, const char *dist_name,
+	perf_counters *counters) {
+	int64_t values[PERF_COUNT], totals[PERF_COUNT] = {0};
+	double elapsed = 0, per_element;
+	int reps = 0, i;
+
+	//Repeat until the timed part alone is long enough to trust
+	while(elapsed < MIN_BENCH_NS) {
+		double start;
+
+		kern->setup(state);
+
+		perf_start(counters);
+		start = now_ns();
+		kern->run(state);
+		elapsed += now_ns() - start;
+		perf_stop(counters, values);
+
+		for(i = 0; i < PERF_COUNT; ++i) {
+			totals[i] = ((values[i] < 0) || (totals[i] < 0)) ? -1 : totals[i] + values[i];
+		}
+		reps++;
+	}
+
+	per_element = (double)reps * state->size;
+	printf("%s,%s,%zu,%zu,%d,%.3f", kern->name, dist_name, state->size,
+		state->size * sizeof(int), reps, elapsed / per_element);
+	for(i = 0; i < PERF_COUNT; ++i) {
+		printf(",%.4f", (totals[i] < 0) ? -1.0 : totals[i] / per_element);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+double now_ns(void) {
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+int cmp_int(const void *a, const void *b) {
+	int x = *(const int*)a, y = *(const int*)b;
+
+	return (x > y) - (x < y);
+}
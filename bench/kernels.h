@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+//Entry points into the static kernels of the sort engines, defined at the end of each
+//engine source when it is compiled with -DSORT_KERNELS
+
+//serial_qsort partition step over arr[0..size-1], pivot is the last element
+size_t kernel_qsort_partition(int arr[], size_t size);
+
+//PSRS linear splitter scan, returns the first index with arr[i] > pivot
+size_t kernel_psrs_partition(int arr[], size_t size, int pivot);
+//PSRS comm_sz-way merge
+size_t kernel_psrs_merge(int arr[], int *sublists[], size_t list_counts[], int n_lists);
+int kernel_min_index(int values[], int mask[], int n);
+
+//hyperquicksort merge of in_result[start..stop-1] with in_scratch
+size_t kernel_hqs_merge(int in_result[], size_t start, size_t stop, int in_scratch[],
+	size_t scratch_size, int merge_scratch[]);
+
+//merge_sort merge of arr with arr_2 into arr, scratch holds arr_size+arr_2_size elements
+void kernel_merge_sort_merge(int arr[], size_t arr_size, int arr_2[], size_t arr_2_size,
+	int scratch[]);
+
+//binary_sort merge and serial binary insertion search
+void kernel_binary_sort_merge(int arr[], size_t arr_size, int arr_2[], size_t arr_2_size,
+	int scratch[]);
+size_t kernel_binary_search(int arr[], size_t size, int value);
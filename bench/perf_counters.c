@@ -0,0 +1,70 @@
+#include "perf_counters.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const uint64_t configs[PERF_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_MISSES
+};
+
+void perf_open(perf_counters *counters) {
+	int i;
+
+	for(i = 0; i < PERF_COUNT; ++i) {
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		counters->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+}
+
+void perf_start(perf_counters *counters) {
+	int i;
+
+	for(i = 0; i < PERF_COUNT; ++i) {
+		if(counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void perf_stop(perf_counters *counters, int64_t values[PERF_COUNT]) {
+	int i;
+
+	for(i = 0; i < PERF_COUNT; ++i) {
+		values[i] = -1;
+		if(counters->fd[i] >= 0) {
+			uint64_t value;
+
+			ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			if(read(counters->fd[i], &value, sizeof(value)) == sizeof(value)) {
+				values[i] = value;
+			}
+		}
+	}
+}
+
+void perf_close(perf_counters *counters) {
+	int i;
+
+	for(i = 0; i < PERF_COUNT; ++i) {
+		if(counters->fd[i] >= 0) {
+			close(counters->fd[i]);
+		}
+		counters->fd[i] = -1;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#define PERF_CYCLES			0
+#define PERF_INSTRUCTIONS	1
+#define PERF_BRANCH_MISSES	2
+#define PERF_LLC_MISSES		3
+#define PERF_COUNT			4
+
+//Hardware counters of the calling thread, user space only. Counters the kernel refuses
+//(no PMU, perf_event_paranoid) read as -1.
+typedef struct {
+	int fd[PERF_COUNT];
+} perf_counters;
+
+void perf_open(perf_counters *counters);
+void perf_start(perf_counters *counters);
+void perf_stop(perf_counters *counters, int64_t values[PERF_COUNT]);
+void perf_close(perf_counters *counters);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+//Scratch memory for one sort, carved from a single reservation. Reservations of a huge
+//page or more use explicit huge pages when the system has some reserved, else
+//MPI_Alloc_mem memory advised for transparent huge pages, so MPI sees one long-lived
+//registered region. Callers size the reservation to their own share of the data.
+//Pages are first touched when a buffer is carved, by the thread carving it, so page
+//faults happen once per sort instead of inside its loops; the rest of the reservation is
+//only committed if it is ever carved or written. Buffers are released in LIFO
+//order by rolling back to a mark; requests beyond the reservation spill to the heap and
+//are released the same way.
+//Every buffer starts on its own cache line, so a carve may use this much more than asked
+#define ARENA_ALIGN			64
+
+typedef struct arena_block arena_block;
+
+typedef struct {
+	char *base;				//Start of the usable range, huge page aligned if that large
+	size_t size;
+	size_t used;
+	size_t touched;			//End of the range first touched so far
+	void *alloc;			//What was mapped or allocated, for arena_free()
+	size_t map_size;		//Bytes mapped with MAP_HUGETLB, 0 for MPI_Alloc_mem memory
+	arena_block *overflow;	//Heap blocks of requests that did not fit
+} arena;
+
+//Position to roll an arena back to
+typedef struct {
+	size_t used;
+	arena_block *overflow;
+} arena_pos;
+
+void arena_init(arena *scratch, size_t size);
+void *arena_alloc(arena *scratch, size_t size);
+//Carves size bytes but first touches only the leading touch bytes, for buffers sized for
+//a worst case that is rarely reached
+void *arena_alloc_partial(arena *scratch, size_t size, size_t touch);
+arena_pos arena_mark(arena *scratch);
+void arena_release(arena *scratch, arena_pos mark);
+void arena_free(arena *scratch);
@@ -1,20 +1,30 @@
 #include "binary_sort.h"
+#include "large_count.h"
+#include "arena.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <mpi.h>
 
-static void binary_sort_rec(int arr[], int arr_start, int arr_end, int my_rank, int p_start,
-	int p_end);
+static void binary_sort_rec(int arr[], size_t arr_start, size_t arr_end, int my_rank,
+	int p_start, int p_end, arena *memory);
 
-static void merge(int arr[], int arr_size, int arr_2[], int arr_2_size);
+static void merge(int arr[], size_t arr_size, int arr_2[], size_t arr_2_size, int scratch[]);
+static size_t working_set(size_t size, int my_rank, int p_start, int p_end);
 
 void binary_sort(int arr[], size_t size, int my_rank, int comm_sz) {
-	binary_sort_rec(arr, 0, size, my_rank, 0, comm_sz);
+	arena memory;
+
+	//Received halves and merge buffers of every level live in one arena, sized for what
+	//this process carves rather than the whole input
+	arena_init(&memory, working_set(size, my_rank, 0, comm_sz));
+	binary_sort_rec(arr, 0, size, my_rank, 0, comm_sz, &memory);
+	arena_free(&memory);
 }
 
-void binary_sort_rec(int arr[], int arr_start, int arr_end, int my_rank, int p_start, int p_end) {
+void binary_sort_rec(int arr[], size_t arr_start, size_t arr_end, int my_rank, int p_start,
+	int p_end, arena *memory) {
 	MPI_Status status;
 
 	if((p_end - p_start) <= 1) {
@@ -26,59 +36,81 @@ void binary_sort_rec(int arr[], int arr_start, int arr_end, int my_rank, int p_s
 		int split = p_start + (p_end - p_start)/2 + ((p_end - p_start) % 2);
 		int lower_p_start = p_start, lower_p_end = split,
 			upper_p_start = split, upper_p_end = p_end;
-		int arr_split = arr_start + (arr_start + arr_end)/2;
+		size_t arr_split = arr_start + (arr_start + arr_end)/2;
 		int *scratch = NULL;
-		int split_size = arr_end - arr_split;
+		size_t split_size = arr_end - arr_split;
+		arena_pos mark = arena_mark(memory);
 
 		//Split array in half and send to other process
 		if(my_rank == p_start) {
 			//Send upper half of array
-			MPI_Send(arr + arr_start + arr_split, arr_end - arr_split, MPI_INT, split,
+			lc_send(arr + arr_start + arr_split, arr_end - arr_split, MPI_INT, split,
 				0, MPI_COMM_WORLD);
 		}
 		else if(my_rank == split) {
-			scratch = (int*)malloc(split_size * sizeof(int));
+			scratch = (int*)arena_alloc(memory, split_size * sizeof(int));
 			
 			//Receive upper half of array
-			MPI_Recv(scratch, split_size, MPI_INT, p_start, 0, MPI_COMM_WORLD, &status);
+			lc_recv(scratch, split_size, MPI_INT, p_start, 0, MPI_COMM_WORLD, &status);
 		}
 
 		//Recurse
 		if(my_rank < split) {
 			//Lower-half processes
-			binary_sort_rec(arr, arr_start, arr_split, my_rank, p_start, split);
+			binary_sort_rec(arr, arr_start, arr_split, my_rank, p_start, split, memory);
 		}
 		else {
 			//Upper-half processes
-			binary_sort_rec(scratch, 0, split_size, my_rank, split, p_end);
+			binary_sort_rec(scratch, 0, split_size, my_rank, split, p_end, memory);
 		}
 
 		//Merge both sorted halves
 		if(my_rank == p_start) {
-			scratch = (int*)malloc(split_size * sizeof(int));
+			scratch = (int*)arena_alloc(memory, split_size * sizeof(int));
 
 			//Receive sorted half
-			MPI_Recv(scratch, split_size, MPI_INT, split, 0, MPI_COMM_WORLD, &status);
+			lc_recv(scratch, split_size, MPI_INT, split, 0, MPI_COMM_WORLD, &status);
 
 			//Merge both sorted arrays
-			merge(arr + arr_start, arr_split - arr_start, scratch, split_size);
-
-			free(scratch);
+			merge(arr + arr_start, arr_split - arr_start, scratch, split_size,
+				(int*)arena_alloc(memory, (arr_split - arr_start + split_size) * sizeof(int)));
 		}
 		else if(my_rank == split) {
 			//Send sorted half
-			MPI_Send(scratch, split_size, MPI_INT, p_start, 0, MPI_COMM_WORLD);
-
-			free(scratch);
+			lc_send(scratch, split_size, MPI_INT, p_start, 0, MPI_COMM_WORLD);
 		}
+
+		arena_release(memory, mark);
 	}
 }
 
+size_t working_set(size_t size, int my_rank, int p_start, int p_end) {
+	//Largest amount of arena this process holds at once in the recursion over size
+	//elements on processes p_start..p_end-1, padding included
+	if((p_end - p_start) <= 1) {
+		return 0;
+	}
+
+	int split = p_start + (p_end - p_start)/2 + ((p_end - p_start) % 2);
+	size_t arr_split = size/2, split_size = size - arr_split;
 
-void merge(int arr[], int arr_size, int arr_2[], int arr_2_size) {
-	int *scratch = (int*)malloc((arr_size + arr_2_size) * sizeof(int));
+	if(my_rank < split) {
+		//The lower recursion is released before the received half and merge buffer
+		size_t lower = working_set(arr_split, my_rank, p_start, split),
+			merged = (my_rank == p_start) ?
+			(split_size + size) * sizeof(int) + 2 * ARENA_ALIGN : 0;
+
+		return (lower > merged) ? lower : merged;
+	}
+
+	//The received upper half is held through the upper recursion
+	return ((my_rank == split) ? split_size * sizeof(int) + ARENA_ALIGN : 0) +
+		working_set(split_size, my_rank, split, p_end);
+}
 
-	int i_scratch = 0, i_arr = 0, i_arr_2 = 0;
+
+void merge(int arr[], size_t arr_size, int arr_2[], size_t arr_2_size, int scratch[]) {
+	size_t i_scratch = 0, i_arr = 0, i_arr_2 = 0;
 
 	for(; (i_arr < arr_size) && (i_arr_2 < arr_2_size); ++i_scratch) {
 		if(arr[i_arr] < arr_2[i_arr_2]) {
@@ -96,6 +128,13 @@ void merge(int arr[], int arr_size, int arr_2[], int arr_2_size) {
 	}
 
 	memcpy(arr, scratch, (arr_size + arr_2_size) * sizeof(int));
+}
+
+#ifdef SORT_KERNELS
+#include "kernels.h"
 
-	free(scratch);
+void kernel_binary_sort_merge(int arr[], size_t arr_size, int arr_2[], size_t arr_2_size,
+	int scratch[]) {
+	merge(arr, arr_size, arr_2, arr_2_size, scratch);
 }
+#endif
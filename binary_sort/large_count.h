@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mpi.h>
+
+//Element counts and offsets are size_t; these wrappers carry them through MPI.
+//MPI-4 libraries use the _c large-count calls, older ones fall back to derived
+//contiguous datatypes so a single message may exceed INT_MAX elements.
+
+//MPI datatype matching size_t
+#define MPI_SIZE_T		MPI_UINT64_T
+
+void lc_send(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm);
+void lc_recv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Status *status);
+void lc_isend(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm, MPI_Request *request);
+void lc_irecv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Request *request);
+//Receives a message matched by MPI_Mprobe or MPI_Improbe
+void lc_mrecv(void *buf, size_t count, MPI_Datatype type, MPI_Message *message,
+	MPI_Status *status);
+
+//Number of elements of type in a received or probed message
+size_t lc_get_count(MPI_Status *status, MPI_Datatype type);
+
+void lc_gatherv(const void *send_buf, size_t send_count, void *recv_buf,
+	const size_t recv_counts[], const size_t displs[], MPI_Datatype type, int root,
+	MPI_Comm comm);
+void lc_alltoallv(const void *send_buf, const size_t send_counts[],
+	const size_t send_displs[], void *recv_buf, const size_t recv_counts[],
+	const size_t recv_displs[], MPI_Datatype type, MPI_Comm comm);
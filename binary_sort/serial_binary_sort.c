@@ -3,13 +3,13 @@
 #include <string.h>
 #include <stdio.h>
 
-static int binary_search(int arr[], size_t start, size_t stop, int value);
+static size_t binary_search(int arr[], size_t start, size_t stop, int value);
 
 void serial_binary_sort(int arr[], size_t size) {
-	int i;
+	size_t i;
 	for(i = 1; i < size; ++i) {
 		int value = arr[i];
-		int insert_loc = binary_search(arr, 0, i, value);
+		size_t insert_loc = binary_search(arr, 0, i, value);
 
 		if(insert_loc < i) {
 			memmove(arr + insert_loc + 1, arr + insert_loc, (i - insert_loc) * sizeof(int));
@@ -18,7 +18,7 @@ void serial_binary_sort(int arr[], size_t size) {
 	}
 }
 
-int binary_search(int arr[], size_t start, size_t stop, int value) {
+size_t binary_search(int arr[], size_t start, size_t stop, int value) {
 	size_t middle = start + (stop - start)/2;
 
 	if((stop - start) <= 1) {
@@ -35,3 +35,11 @@ int binary_search(int arr[], size_t start, size_t stop, int value) {
 		return binary_search(arr, middle, stop, value);
 	}
 }
+
+#ifdef SORT_KERNELS
+#include "kernels.h"
+
+size_t kernel_binary_search(int arr[], size_t size, int value) {
+	return binary_search(arr, 0, size, value);
+}
+#endif
@@ -0,0 +1,141 @@
+#include "bitonic_sort.h"
+#include "serial_qsort.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <mpi.h>
+
+static void compare_split(int arr[], int scratch[], int merge_scratch[], size_t block,
+	int partner, int keep_low);
+
+static int hcube_size(int comm_sz);
+
+static size_t last_block = 0;
+
+void bitonic_sort(int arr[], size_t size, int my_rank, int comm_sz) {
+	//Every process holds exactly block elements. The hypercube is padded to a power of two
+	//with virtual processes whose blocks are all INT_MAX; as they always sit above their
+	//partner and keep the high half, their blocks never change and their steps are skipped
+	int cube_sz = hcube_size(comm_sz);
+	size_t block = (size + comm_sz - 1) / comm_sz;
+	int *my_arr, *scratch, *merge_scratch, *padded = NULL;
+	MPI_Status status;
+	size_t j;
+	int i;
+
+	last_block = block;
+	my_arr = (int*)malloc(block * sizeof(int));
+	scratch = (int*)malloc(block * sizeof(int));
+	merge_scratch = (int*)malloc(block * sizeof(int));
+
+	if(my_rank == 0) {
+		//Pad the array with INT_MAX so it splits into equal blocks
+		padded = (int*)malloc(block * comm_sz * sizeof(int));
+		memcpy(padded, arr, size * sizeof(int));
+		for(j = size; j < block * comm_sz; ++j) {
+			padded[j] = INT_MAX;
+		}
+
+		//Send array chunks to other processes
+		for(i = 1; i < comm_sz; ++i) {
+			lc_send(padded + i*block, block, MPI_INT, i, 0, MPI_COMM_WORLD);
+		}
+		memcpy(my_arr, padded, block * sizeof(int));
+	}
+	else {
+		//Receive array chunk from master
+		lc_recv(my_arr, block, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
+	}
+
+	//Sort my array chunk using serial quicksort
+	serial_qsort(my_arr, block);
+
+	//Blocks of 2^stage processes are sorted ascending: the first step pairs each process
+	//with its mirror in the block, the following ones with a fixed partner per dimension
+	int stage, dim;
+	for(stage = 1; (1 << stage) <= cube_sz; ++stage) {
+		for(dim = stage - 1; dim >= 0; --dim) {
+			int partner = (dim == stage - 1) ? (my_rank ^ ((1 << stage) - 1)) :
+				(my_rank ^ (1 << dim));
+
+			if(partner < comm_sz) {
+				compare_split(my_arr, scratch, merge_scratch, block, partner,
+					my_rank < partner);
+			}
+		}
+	}
+
+	//Gather equal sized blocks at root and drop the padding
+	if(my_rank == 0) {
+		for(i = 1; i < comm_sz; ++i) {
+			lc_recv(padded + i*block, block, MPI_INT, i, 0, MPI_COMM_WORLD, &status);
+		}
+		memcpy(padded, my_arr, block * sizeof(int));
+		memcpy(arr, padded, size * sizeof(int));
+
+		free(padded);
+	}
+	else {
+		lc_send(my_arr, block, MPI_INT, 0, 0, MPI_COMM_WORLD);
+	}
+
+	free(my_arr);
+	free(scratch);
+	free(merge_scratch);
+}
+
+size_t bitonic_block_size(void) {
+	return last_block;
+}
+
+void compare_split(int arr[], int scratch[], int merge_scratch[], size_t block,
+	int partner, int keep_low) {
+	MPI_Request request;
+	size_t i_out;
+
+	//Exchange whole blocks with partner
+	lc_irecv(scratch, block, MPI_INT, partner, 0, MPI_COMM_WORLD, &request);
+	lc_send(arr, block, MPI_INT, partner, 0, MPI_COMM_WORLD);
+	MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+	if(keep_low) {
+		//Merge from the front, keeping the block smallest values
+		size_t i_arr = 0, i_scratch = 0;
+		for(i_out = 0; i_out < block; ++i_out) {
+			if((i_scratch == block) ||
+				((i_arr < block) && (arr[i_arr] <= scratch[i_scratch]))) {
+				merge_scratch[i_out] = arr[i_arr++];
+			}
+			else {
+				merge_scratch[i_out] = scratch[i_scratch++];
+			}
+		}
+	}
+	else {
+		//Merge from the back, keeping the block largest values
+		size_t i_arr = block, i_scratch = block;
+		for(i_out = block; i_out > 0; --i_out) {
+			if((i_scratch == 0) ||
+				((i_arr > 0) && (arr[i_arr-1] > scratch[i_scratch-1]))) {
+				merge_scratch[i_out-1] = arr[--i_arr];
+			}
+			else {
+				merge_scratch[i_out-1] = scratch[--i_scratch];
+			}
+		}
+	}
+
+	memcpy(arr, merge_scratch, block * sizeof(int));
+}
+
+int hcube_size(int comm_sz) {
+	int size = 1;
+
+	while(size < comm_sz) {
+		size <<= 1;
+	}
+
+	return size;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+//Any number of processes takes part, each with ceil(size/comm_sz) elements; a process
+//count that is not a power of two is padded with virtual processes holding INT_MAX
+void bitonic_sort(int arr[], size_t size, int my_rank, int comm_sz);
+
+//Elements this process held in the last bitonic_sort() call, padding included
+size_t bitonic_block_size(void);
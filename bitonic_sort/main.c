@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h> 
+
+#include "bitonic_sort.h"
+#include "large_count.h"
+
+#define ARRAY_SIZE		1024
+
+void print_array(int* arr, size_t size);
+
+int main(void) {
+   int my_rank, comm_sz;
+
+   MPI_Init(NULL, NULL); 
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
+
+	int* arr;
+	if(my_rank == 0) {
+		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+	
+	bitonic_sort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Validation successful!\n");
+		}
+		else {
+			printf("[Error] Validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+
+	}
+
+	//Every process takes part, also when comm_sz is not a power of two
+	size_t block = bitonic_block_size(), min_block;
+	MPI_Reduce(&block, &min_block, 1, MPI_SIZE_T, MPI_MIN, 0, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		size_t expected = (ARRAY_SIZE + comm_sz - 1) / comm_sz;
+
+		if(min_block == expected) {
+			printf("[Info] Participation validation successful (%d processes with %zu)!\n",
+				comm_sz, min_block);
+		}
+		else {
+			printf("[Error] Participation validation not successful (%zu < %zu) :(\n",
+				min_block, expected);
+		}
+
+		free(arr);
+	}
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+void print_array(int* arr, size_t size) {
+	printf("\t");
+	int i;
+	for(i = 0; i < size; ++i) {
+		printf("%d ", arr[i]);
+	}
+	printf("\n");
+}
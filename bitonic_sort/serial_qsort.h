@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+
+void serial_qsort(int* arr, size_t size);
+int validate(int* arr, size_t size);
+
+void inline swap(int* a, int* b);
@@ -0,0 +1,391 @@
+#include "histogram_sort.h"
+#include "serial_qsort.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <mpi.h>
+
+static size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz);
+static void find_splitters(int my_arr[], size_t count, size_t size, double epsilon,
+	int sample_size, size_t cuts[], int comm_sz);
+static void split_ties(int my_arr[], size_t count, long long keys[], long long takes[],
+	int tied[], size_t cuts[], int n_splitters);
+static size_t exchange(int **my_arr, size_t count, size_t cuts[], int comm_sz);
+static void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz);
+
+static size_t upper_bound(int arr[], size_t start, size_t end, long long value);
+static size_t lower_bound(int arr[], size_t start, size_t end, long long value);
+static size_t merge(int arr[], int *sublists[], size_t list_counts[], int n_lists);
+static int min_index(int *values, int *mask, int n);
+
+static size_t max_count = 0;
+
+void histogram_sort(int arr[], size_t size, double epsilon, int sample_size, int my_rank,
+	int comm_sz) {
+	int *my_arr;
+	size_t *cuts = (size_t*)malloc(comm_sz * sizeof(size_t));
+	size_t count;
+
+	//Distribute partial lists to all processes
+	count = scatter(arr, size, &my_arr, my_rank, comm_sz);
+
+	//Each process sorts partial list
+	serial_qsort(my_arr, count);
+
+	//Refine splitters until every process receives its share of size/comm_sz
+	find_splitters(my_arr, count, size, epsilon, sample_size, cuts, comm_sz);
+
+	//Exchange sublists and merge them into sorted list
+	count = exchange(&my_arr, count, cuts, comm_sz);
+	MPI_Allreduce(&count, &max_count, 1, MPI_SIZE_T, MPI_MAX, MPI_COMM_WORLD);
+
+	//Gather all partial lists at root
+	gather(my_arr, count, arr, my_rank, comm_sz);
+
+	free(cuts);
+	free(my_arr);
+}
+
+size_t histogram_max_partition(void) {
+	return max_count;
+}
+
+size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz) {
+	size_t count;
+
+	if(my_rank == 0) {
+		//Send array chunks to other processes
+		int i;
+		for(i = 1; i < comm_sz; ++i) {
+			size_t start = i*size/comm_sz,
+				end = (i+1)*size/comm_sz;
+
+			lc_send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
+		}
+
+		count = size/comm_sz;
+		*my_arr = (int*)malloc(count * sizeof(int));
+		memcpy(*my_arr, arr, count * sizeof(int));
+	}
+	else {
+		//Receive array chunk from master
+		MPI_Status status;
+		MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+		count = lc_get_count(&status, MPI_INT);
+
+		*my_arr = (int*)malloc(count * sizeof(int));
+		lc_recv(*my_arr, count, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	return count;
+}
+
+void find_splitters(int my_arr[], size_t count, size_t size, double epsilon,
+	int sample_size, size_t cuts[], int comm_sz) {
+	int n_splitters = comm_sz - 1, total_samples = sample_size * comm_sz;
+	int *samples = (int*)malloc(sample_size * sizeof(int)),
+		*all_samples = (int*)malloc(total_samples * sizeof(int)),
+		*settled = (int*)malloc(comm_sz * sizeof(int)),
+		*tied = (int*)malloc(comm_sz * sizeof(int));
+	long long *low = (long long*)malloc(comm_sz * sizeof(long long)),
+		*high = (long long*)malloc(comm_sz * sizeof(long long)),
+		*low_rank = (long long*)malloc(comm_sz * sizeof(long long)),
+		*high_rank = (long long*)malloc(comm_sz * sizeof(long long)),
+		*candidates = (long long*)malloc(comm_sz * sizeof(long long)),
+		*local_ranks = (long long*)malloc(comm_sz * sizeof(long long)),
+		*global_ranks = (long long*)malloc(comm_sz * sizeof(long long)),
+		*takes = (long long*)malloc(comm_sz * sizeof(long long));
+	//Both splitters bounding a process may be off, so each gets half of the allowance
+	double tolerance = epsilon * size / (2.0 * comm_sz);
+	int i, remaining = n_splitters;
+
+	//Initial candidates are quantiles of regular samples from every process
+	for(i = 0; i < sample_size; ++i) {
+		samples[i] = (count > 0) ? my_arr[i*count/sample_size] : INT_MAX;
+	}
+	MPI_Allgather(samples, sample_size, MPI_INT, all_samples, sample_size, MPI_INT,
+		MPI_COMM_WORLD);
+	serial_qsort(all_samples, total_samples);
+
+	for(i = 0; i < n_splitters; ++i) {
+		//A splitter is bracketed by the keys whose global ranks fall below/above its target
+		low[i] = (long long)INT_MIN - 1;
+		low_rank[i] = 0;
+		high[i] = INT_MAX;
+		high_rank[i] = size;
+		candidates[i] = all_samples[(size_t)(i+1)*total_samples/comm_sz];
+		settled[i] = 0;
+		tied[i] = 0;
+	}
+
+	while(remaining > 0) {
+		//Global rank of each candidate is the sum of local binary search counts
+		for(i = 0; i < n_splitters; ++i) {
+			local_ranks[i] = upper_bound(my_arr, 0, count, candidates[i]);
+		}
+		MPI_Allreduce(local_ranks, global_ranks, n_splitters, MPI_LONG_LONG, MPI_SUM,
+			MPI_COMM_WORLD);
+
+		//Every process refines the same brackets, so no broadcast is needed
+		for(i = 0; i < n_splitters; ++i) {
+			long long target = (i+1)*size/comm_sz;
+
+			if(settled[i]) {
+				continue;
+			}
+
+			if(global_ranks[i] < target - tolerance) {
+				low[i] = candidates[i];
+				low_rank[i] = global_ranks[i];
+			}
+			else if(global_ranks[i] > target + tolerance) {
+				high[i] = candidates[i];
+				high_rank[i] = global_ranks[i];
+			}
+			else {
+				settled[i] = 1;
+				remaining--;
+				continue;
+			}
+
+			if(high[i] - low[i] <= 1) {
+				//No key value lands within epsilon, so a single key spans the target; its
+				//run is split by global position so that exactly target keys go left
+				candidates[i] = high[i];
+				takes[i] = target - low_rank[i];
+				tied[i] = 1;
+				settled[i] = 1;
+				remaining--;
+			}
+			else {
+				//Bisect the key range of the bracket
+				candidates[i] = low[i] + (high[i] - low[i]) / 2;
+			}
+		}
+	}
+
+	split_ties(my_arr, count, candidates, takes, tied, cuts, n_splitters);
+
+	free(samples);
+	free(all_samples);
+	free(settled);
+	free(tied);
+	free(takes);
+	free(low);
+	free(high);
+	free(low_rank);
+	free(high_rank);
+	free(candidates);
+	free(local_ranks);
+	free(global_ranks);
+}
+
+void split_ties(int my_arr[], size_t count, long long keys[], long long takes[],
+	int tied[], size_t cuts[], int n_splitters) {
+	long long *equal = (long long*)malloc((n_splitters + 1) * sizeof(long long)),
+		*before = (long long*)calloc(n_splitters + 1, sizeof(long long));
+	int my_rank, i;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+	//Local cut after every key not above the splitter; a tied splitter first cuts before
+	//its key and then takes this process's share of the equal keys
+	for(i = 0; i < n_splitters; ++i) {
+		if(tied[i]) {
+			cuts[i] = lower_bound(my_arr, 0, count, keys[i]);
+			equal[i] = upper_bound(my_arr, cuts[i], count, keys[i]) - cuts[i];
+		}
+		else {
+			cuts[i] = upper_bound(my_arr, 0, count, keys[i]);
+			equal[i] = 0;
+		}
+	}
+
+	//Equal keys held by lower ranks go left first
+	MPI_Exscan(equal, before, n_splitters, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		memset(before, 0, n_splitters * sizeof(long long));
+	}
+
+	for(i = 0; i < n_splitters; ++i) {
+		if(tied[i]) {
+			long long take = takes[i] - before[i];
+
+			cuts[i] += (take <= 0) ? 0 : ((take > equal[i]) ? equal[i] : take);
+		}
+		if((i > 0) && (cuts[i] < cuts[i-1])) {
+			cuts[i] = cuts[i-1];
+		}
+	}
+
+	free(equal);
+	free(before);
+}
+
+size_t exchange(int **my_arr, size_t count, size_t cuts[], int comm_sz) {
+	size_t *send_counts = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*send_displs = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	int **sublists = (int**)malloc(comm_sz * sizeof(int*));
+	int *recv_arr, *merged;
+	size_t recv_total;
+	int i;
+
+	//Split sorted list into one sublist per process
+	size_t list_start = 0;
+	for(i = 0; i < comm_sz; ++i) {
+		size_t list_end = (i == (comm_sz - 1)) ? count : cuts[i];
+
+		send_displs[i] = list_start;
+		send_counts[i] = list_end - list_start;
+
+		list_start = list_end;
+	}
+
+	//Exchange sublist sizes so receive buffers fit exactly
+	MPI_Alltoall(send_counts, 1, MPI_SIZE_T, recv_counts, 1, MPI_SIZE_T, MPI_COMM_WORLD);
+
+	recv_total = 0;
+	for(i = 0; i < comm_sz; ++i) {
+		recv_displs[i] = recv_total;
+		recv_total += recv_counts[i];
+	}
+
+	//Send and receive sublists
+	recv_arr = (int*)malloc(recv_total * sizeof(int));
+	lc_alltoallv(*my_arr, send_counts, send_displs, recv_arr, recv_counts, recv_displs,
+		MPI_INT, MPI_COMM_WORLD);
+
+	//Merge all sublists into sorted list
+	for(i = 0; i < comm_sz; ++i) {
+		sublists[i] = recv_arr + recv_displs[i];
+	}
+	merged = (int*)malloc(recv_total * sizeof(int));
+	count = merge(merged, sublists, recv_counts, comm_sz);
+
+	free(*my_arr);
+	*my_arr = merged;
+
+	free(recv_arr);
+	free(sublists);
+	free(send_counts);
+	free(send_displs);
+	free(recv_counts);
+	free(recv_displs);
+
+	return count;
+}
+
+void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz) {
+	size_t *recv_counts = NULL, *displacements = NULL;
+	int i;
+
+	//Gather partial list counts at root
+	if(my_rank == 0) {
+		recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displacements = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&count, 1, MPI_SIZE_T, recv_counts, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		displacements[0] = 0;
+		for(i = 1; i < comm_sz; ++i) {
+			displacements[i] = displacements[i-1] + recv_counts[i-1];
+		}
+	}
+
+	//Gather all partial lists at root
+	lc_gatherv(my_arr, count, arr, recv_counts, displacements, MPI_INT, 0, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		free(recv_counts);
+		free(displacements);
+	}
+}
+
+size_t upper_bound(int arr[], size_t start, size_t end, long long value) {
+	//Index of the first element greater than value
+	while(start < end) {
+		size_t middle = start + (end - start)/2;
+
+		if(arr[middle] <= value) {
+			start = middle + 1;
+		}
+		else {
+			end = middle;
+		}
+	}
+
+	return start;
+}
+
+size_t lower_bound(int arr[], size_t start, size_t end, long long value) {
+	//Index of the first element not less than value
+	while(start < end) {
+		size_t middle = start + (end - start)/2;
+
+		if(arr[middle] < value) {
+			start = middle + 1;
+		}
+		else {
+			end = middle;
+		}
+	}
+
+	return start;
+}
+
+size_t merge(int arr[], int *sublists[], size_t list_counts[], int n_lists) {
+	size_t *i_sublists = (size_t*)malloc(n_lists * sizeof(size_t));
+	int *sub_values = (int*)malloc(n_lists * sizeof(int)),
+		*value_valid = (int*)malloc(n_lists * sizeof(int));
+
+	size_t i_arr = 0;
+
+	int i;
+	for(i = 0; i < n_lists; ++i) {
+		i_sublists[i] = 0;
+	}
+
+	for(;;) {
+		int sub_value_count = 0;
+		for(i = 0; i < n_lists; ++i) {
+			if(i_sublists[i] < list_counts[i]) {
+				sub_values[i] = sublists[i][i_sublists[i]];
+				value_valid[i] = 1;
+				sub_value_count++;
+			}
+			else {
+				value_valid[i] = 0;
+			}
+		}
+		if(sub_value_count == 0) {
+			break;
+		}
+
+		int min_list = min_index(sub_values, value_valid, n_lists);
+		arr[i_arr++] = sublists[min_list][i_sublists[min_list]++];
+	}
+
+	free(i_sublists);
+	free(sub_values);
+	free(value_valid);
+
+	return i_arr;
+}
+
+int min_index(int *values, int *mask, int n) {
+	int min = INT_MAX, min_index = -1;
+
+	int i;
+	for(i = 0; i < n; ++i) {
+		if(mask[i] && ((min_index < 0) || (values[i] < min))) {
+			min = values[i];
+			min_index = i;
+		}
+	}
+
+	return min_index;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+
+//Splitters are refined until every process holds within epsilon*size/comm_sz of
+//size/comm_sz elements, starting from sample_size regular samples per process. A key
+//spanning a splitter's target is split between processes by global position.
+void histogram_sort(int arr[], size_t size, double epsilon, int sample_size, int my_rank,
+	int comm_sz);
+
+//Largest partition any process held in the last histogram_sort() call
+size_t histogram_max_partition(void);
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h> 
+
+#include "histogram_sort.h"
+
+#define ARRAY_SIZE		1024
+#define EPSILON			0.05
+#define SAMPLE_SIZE		8
+
+void check_balance(const char *name, int my_rank, int comm_sz);
+void print_array(int* arr, size_t size);
+
+int main(void) {
+   int my_rank, comm_sz;
+
+   MPI_Init(NULL, NULL); 
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
+
+	int* arr;
+	if(my_rank == 0) {
+		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+	
+	histogram_sort(arr, ARRAY_SIZE, EPSILON, SAMPLE_SIZE, my_rank, comm_sz);
+	
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Validation successful!\n");
+		}
+		else {
+			printf("[Error] Validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+	check_balance("Balance", my_rank, comm_sz);
+
+	//Every other element is the same key, so most splitters fall inside its run
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = (i % 2) ? 7 : rand() % 100;
+		}
+	}
+
+	histogram_sort(arr, ARRAY_SIZE, EPSILON, SAMPLE_SIZE, my_rank, comm_sz);
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Heavy key validation successful!\n");
+		}
+		else {
+			printf("[Error] Heavy key validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+
+		free(arr);
+	}
+	check_balance("Heavy key balance", my_rank, comm_sz);
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+void check_balance(const char *name, int my_rank, int comm_sz) {
+	//Targets are rounded down, so a partition may hold one element more
+	size_t max_count = histogram_max_partition(),
+		bound = (size_t)((1 + EPSILON) * ARRAY_SIZE / comm_sz) + 1;
+
+	if(my_rank == 0) {
+		if(max_count <= bound) {
+			printf("[Info] %s validation successful (%zu <= %zu)!\n", name, max_count, bound);
+		}
+		else {
+			printf("[Error] %s validation not successful (%zu > %zu) :(\n", name, max_count,
+				bound);
+		}
+	}
+}
+
+void print_array(int* arr, size_t size) {
+	printf("\t");
+	int i;
+	for(i = 0; i < size; ++i) {
+		printf("%d ", arr[i]);
+	}
+	printf("\n");
+}
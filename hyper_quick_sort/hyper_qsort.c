@@ -1,38 +1,66 @@
 #include "hyper_qsort.h"
 #include "serial_qsort.h"
+#include "wire_codec.h"
+#include "large_count.h"
+#include "stream_sink.h"
+#include "presort.h"
+#include "arena.h"
+#include "rebalance.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <mpi.h>
 
-size_t hyper_qsort_rec(int arr[], int scratch[], int merge_scratch[], size_t size,
-	size_t scratchSize, int blockStart, int blockEnd, int my_rank);
+//Regular samples every block member sends its root to choose the pivot
+#define PIVOT_SAMPLES		64
+
+//Key of a regular sample and the number of elements it stands for
+typedef struct {
+	int key;
+	size_t weight;
+} pivot_sample;
+
+size_t hyper_qsort_rec(int *arr[], int *scratch[], int *merge_scratch[], size_t size,
+	size_t *capacity, int blockStart, int blockEnd, int my_rank, arena *memory);
 
 static size_t merge(int* in_result, size_t start, size_t stop, int* in_scratch,
 	size_t scratchSize, int* merge_scratch); 
 static size_t partition(int arr[], size_t size, int pivot);
+static size_t partition_lower(int arr[], size_t size, int pivot);
+static int block_pivot(int arr[], size_t size, int blockStart, int blockEnd, int split,
+	int my_rank);
+static size_t split_ties(size_t lower, size_t equal, size_t size, int blockStart,
+	int blockEnd, int split, int my_rank);
+
+static void grow_lists(int *arr[], int *scratch[], int *merge_scratch[], size_t count,
+	size_t *capacity, size_t needed, arena *memory);
 
 static int hcube_level(int start, int end);
-static int median(int arr[], int size);
+static int sample_cmp(const void *a, const void *b);
+
+static size_t max_count = 0;
 
 void hyper_qsort(int arr[], size_t size, int my_rank, int comm_sz) {
-	int* scratch = (int*)malloc(size * sizeof(int));
-	int* merge_scratch = (int*)malloc(size * sizeof(int));
-	int* my_arr = (int*)malloc(size * sizeof(int));
-	int count;
-	int *recvCounts, *displacements;
+	//The list, its receive and merge buffers and the partial lists of every level are
+	//carved from one arena sized for the balanced share. A list the pivots skew past it
+	//moves to larger buffers, which spill to the heap
+	arena memory;
+	size_t capacity = size/comm_sz + 1;
+	arena_init(&memory, 4 * capacity * sizeof(int) + 4 * ARENA_ALIGN);
+	int* scratch = (int*)arena_alloc(&memory, capacity * sizeof(int));
+	int* merge_scratch = (int*)arena_alloc(&memory, capacity * sizeof(int));
+	int* my_arr = (int*)arena_alloc(&memory, capacity * sizeof(int));
+	size_t count;
+	size_t *recvCounts = NULL, *displacements = NULL;
 
 	if(my_rank == 0) {
-		recvCounts = (int*)malloc(comm_sz * sizeof(int));
-		displacements = (int*)malloc(comm_sz * sizeof(int));
-
 		//Send array chunks to other processes
 		int i;
 		for(i = 1; i < comm_sz; ++i) {
 			size_t start = i*size/comm_sz,
 				end = (i+1)*size/comm_sz;
 
-			MPI_Send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
+			lc_send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
 		}
 
 		count = size/comm_sz;
@@ -40,14 +68,20 @@ void hyper_qsort(int arr[], size_t size, int my_rank, int comm_sz) {
 	}
 	else {
 		//Receive array chunk from master
-		my_arr = (int*)malloc(size * sizeof(int));
 		MPI_Status status;
-		MPI_Recv(my_arr, size, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-		MPI_Get_count(&status, MPI_INT, &count);
+		lc_recv(my_arr, capacity, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
+		count = lc_get_count(&status, MPI_INT);
 	}
 
-	//Sort my array chunk using serial quicksort
-	serial_qsort(my_arr, count);
+	//Sort my array chunk using serial quicksort, or the presort pass which also detects
+	//chunks that are already in rank order
+	int in_order = 0;
+	if(presort_enabled()) {
+		in_order = presort_sort(my_arr, count, MPI_COMM_WORLD);
+	}
+	else {
+		serial_qsort(my_arr, count);
+	}
 
 	//Enter recursive hyper_qsort routine
 	/*
@@ -57,9 +91,33 @@ void hyper_qsort(int arr[], size_t size, int my_rank, int comm_sz) {
 			comm_sz);
 	}
 	*/
-	count = hyper_qsort_rec(my_arr, scratch, merge_scratch, count, size, 0, comm_sz, my_rank);
+	if(!in_order) {
+		count = hyper_qsort_rec(&my_arr, &scratch, &merge_scratch, count, &capacity, 0,
+			comm_sz, my_rank, &memory);
+	}
+	MPI_Allreduce(&count, &max_count, 1, MPI_SIZE_T, MPI_MAX, MPI_COMM_WORLD);
+
+	if(rebalance_enabled()) {
+		//Even out the lists, using the scratch list which is free after the recursion
+		int* balanced = scratch;
+		count = rebalance(my_arr, count, balanced, MPI_COMM_WORLD);
+		scratch = my_arr;
+		my_arr = balanced;
+	}
+
+	if(stream_sink_enabled()) {
+		//Hand the sorted lists to the sink's writer chunk by chunk
+		stream_sorted(my_arr, count, my_rank, comm_sz, MPI_COMM_WORLD);
+
+		arena_free(&memory);
+		return;
+	}
 	
-	MPI_Gather(&count, 1, MPI_INT, recvCounts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		recvCounts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displacements = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&count, 1, MPI_SIZE_T, recvCounts, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
 	if(my_rank == 0) {
 		int i;
 		displacements[0] = 0;
@@ -67,17 +125,21 @@ void hyper_qsort(int arr[], size_t size, int my_rank, int comm_sz) {
 			displacements[i] = displacements[i-1] + recvCounts[i-1];
 		}
 	}
-	MPI_Gatherv(my_arr, count, MPI_INT, arr, recvCounts, displacements, MPI_INT,
-		0, MPI_COMM_WORLD);
+	lc_gatherv(my_arr, count, arr, recvCounts, displacements, MPI_INT, 0, MPI_COMM_WORLD);
 	
-	free(my_arr);
-	free(scratch);
+	free(recvCounts);
+	free(displacements);
+	arena_free(&memory);
 }
 
 
-size_t hyper_qsort_rec(int arr[], int scratch[], int merge_scratch[], size_t size,
-	size_t scratchSize, int blockStart, int blockEnd, int my_rank) {
-	
+size_t hyper_qsort_max_partition(void) {
+	return max_count;
+}
+
+size_t hyper_qsort_rec(int *arr[], int *scratch[], int *merge_scratch[], size_t size,
+	size_t *capacity, int blockStart, int blockEnd, int my_rank, arena *memory) {
+
 	if((blockEnd - blockStart) < 2) {
 		//End of recursion
 		return size;
@@ -87,22 +149,14 @@ size_t hyper_qsort_rec(int arr[], int scratch[], int merge_scratch[], size_t siz
 	int split = blockStart + (blockEnd - blockStart) / 2 + ((blockEnd - blockStart) % 2),
 		block_rank = my_rank - blockStart, lowerSubBlockSize = (split - blockStart),
 		upperSubBlockSize = (blockEnd - split), subBlockStart, subBlockEnd;
-	int pivot;
-
-	if(my_rank == blockStart) {
-		//Root always provides the pivot
-		pivot = median(arr, size);
-		
-		int i;
-		for(i = blockStart+1; i < blockEnd; ++i) {
-			MPI_Send(&pivot, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-		}
-	}
-	else {
-		MPI_Recv(&pivot, 1, MPI_INT, blockStart, 0, MPI_COMM_WORLD, &status);
-	}
+	int pivot = block_pivot(*arr, size, blockStart, blockEnd, split, my_rank);
 
-	size_t i_pivot = partition(arr, size, pivot);
+	//Keys below the pivot go to the lower sub-block, keys equal to it are shared out over
+	//the whole block
+	size_t lower = partition_lower(*arr, size, pivot),
+		equal = partition(*arr + lower, size - lower, pivot);
+	size_t i_pivot = lower + split_ties(lower, equal, size, blockStart, blockEnd, split,
+		my_rank);
 
 	if(my_rank < split) {
 		subBlockStart = blockStart;
@@ -112,20 +166,21 @@ size_t hyper_qsort_rec(int arr[], int scratch[], int merge_scratch[], size_t siz
 		//We mod the optimal (power of 2) neighbor with the actual upper sub-block size to efficiently
 		//Split the work with the actual number of available upper block processes
 		int neighbor = (block_rank % upperSubBlockSize) + split;
-		int recv_count;
+		size_t send_count = size - i_pivot, recv_count;
 
+		//Swap list sizes first so the buffers can grow to hold the merged list
+		MPI_Sendrecv(&send_count, 1, MPI_SIZE_T, neighbor, 0, &recv_count, 1, MPI_SIZE_T,
+			neighbor, 0, MPI_COMM_WORLD, &status);
+		grow_lists(arr, scratch, merge_scratch, size, capacity, i_pivot + recv_count, memory);
 
 		//Send upper list to neighbor
-		MPI_Send(arr + i_pivot, size - (i_pivot), MPI_INT, neighbor, 0,
-			MPI_COMM_WORLD);
+		wire_send(*arr + i_pivot, send_count, neighbor, 0, MPI_COMM_WORLD);
 
 		//Receive neighbor's lower list
-		MPI_Recv(scratch, scratchSize, MPI_INT, neighbor, 0, MPI_COMM_WORLD,
-			&status);
-		MPI_Get_count(&status, MPI_INT, &recv_count);
+		recv_count = wire_recv(*scratch, *capacity, neighbor, 0, MPI_COMM_WORLD, &status);
 
 		//Merge lists into sorted intermediate result
-		size = merge(arr, 0, i_pivot, scratch, recv_count, merge_scratch);
+		size = merge(*arr, 0, i_pivot, *scratch, recv_count, *merge_scratch);
 	}
 	else {
 		subBlockStart = split;
@@ -136,42 +191,56 @@ size_t hyper_qsort_rec(int arr[], int scratch[], int merge_scratch[], size_t siz
 		//more than one neighbor
 		int neighbor_count = (lowerSubBlockSize / upperSubBlockSize) +
 			(((lowerSubBlockSize % upperSubBlockSize) > subBlockRank) ? 1 : 0);
-		int sendSize = i_pivot;
-		int scratchEnd = 0;
-
-		int* partialList = (int*)malloc(scratchSize * sizeof(int));
+		size_t sendSize = i_pivot;
+		size_t scratchEnd = 0, recv_total = 0, recv_max = 0;
 
 		int i;
+		for(i = 0; i < neighbor_count; ++i) {
+			int neighbor = blockStart + subBlockRank + i*upperSubBlockSize;
+			size_t send_count = (i+1)*sendSize/neighbor_count - i*sendSize/neighbor_count,
+				recv_count;
+
+			//Swap list sizes first so the buffers can grow to hold the merged list
+			MPI_Sendrecv(&send_count, 1, MPI_SIZE_T, neighbor, 0, &recv_count, 1, MPI_SIZE_T,
+				neighbor, 0, MPI_COMM_WORLD, &status);
+			recv_total += recv_count;
+			recv_max = (recv_count > recv_max) ? recv_count : recv_max;
+		}
+		grow_lists(arr, scratch, merge_scratch, size, capacity, size - i_pivot + recv_total,
+			memory);
+
+		arena_pos mark = arena_mark(memory);
+		int* partialList = (int*)arena_alloc(memory, recv_max * sizeof(int));
+
 		for(i = 0; i < neighbor_count; ++i) {
 			int neighbor = blockStart + subBlockRank + i*upperSubBlockSize;
 
 			//Receive this neighbor's upper list
-			int recv_count;
-			MPI_Recv((scratchEnd > 0) ? partialList : scratch, scratchSize, MPI_INT, neighbor, 0,
-				MPI_COMM_WORLD, &status);
-			MPI_Get_count(&status, MPI_INT, &recv_count);
-			
+			size_t recv_count = wire_recv((scratchEnd > 0) ? partialList : *scratch,
+				(scratchEnd > 0) ? recv_max : *capacity, neighbor, 0, MPI_COMM_WORLD, &status);
+
 			if(scratchEnd > 0) {
 				//Merge this upper list with already received upper lists
-				scratchEnd = merge(scratch, 0, scratchEnd, partialList, recv_count, merge_scratch);
+				scratchEnd = merge(*scratch, 0, scratchEnd, partialList, recv_count,
+					*merge_scratch);
 			}
 			else {
 				scratchEnd = recv_count;
 			}
 
 			//Send part of lower list to this neighbor
-			int sendStart = i*sendSize/neighbor_count, sendEnd = (i+1)*sendSize/neighbor_count;
-			MPI_Send(arr + sendStart, sendEnd - sendStart, MPI_INT, neighbor, 0, MPI_COMM_WORLD);
+			size_t sendStart = i*sendSize/neighbor_count, sendEnd = (i+1)*sendSize/neighbor_count;
+			wire_send(*arr + sendStart, sendEnd - sendStart, neighbor, 0, MPI_COMM_WORLD);
 		}
 
 		//Merge all received lists with my current list
-		size = merge(arr, i_pivot, size, scratch, scratchEnd, merge_scratch);
+		size = merge(*arr, i_pivot, size, *scratch, scratchEnd, *merge_scratch);
 
-		free(partialList);
+		arena_release(memory, mark);
 	}
 
-	size = hyper_qsort_rec(arr, scratch, merge_scratch, size, scratchSize, subBlockStart,
-		subBlockEnd, my_rank);
+	size = hyper_qsort_rec(arr, scratch, merge_scratch, size, capacity, subBlockStart,
+		subBlockEnd, my_rank, memory);
 
 	return size;
 }
@@ -212,6 +281,145 @@ size_t partition(int arr[], size_t size, int pivot) {
 	return i;
 }
 
+size_t partition_lower(int arr[], size_t size, int pivot) {
+	size_t i;
+	for(i = 0; (i < size) && (arr[i] < pivot); ++i);
+
+	return i;
+}
+
+int block_pivot(int arr[], size_t size, int blockStart, int blockEnd, int split,
+	int my_rank) {
+	//Root picks the key at the lower sub-block's share of the block from regular samples
+	//of every member, each weighted by the elements it stands for
+	int keys[PIVOT_SAMPLES], pivot = 0, i;
+	size_t weights[PIVOT_SAMPLES];
+
+	for(i = 0; i < PIVOT_SAMPLES; ++i) {
+		size_t start = i*size/PIVOT_SAMPLES, end = (i+1)*size/PIVOT_SAMPLES;
+
+		keys[i] = (end > start) ? arr[start] : 0;
+		weights[i] = end - start;
+	}
+
+	if(my_rank == blockStart) {
+		int block_sz = blockEnd - blockStart, n_samples = block_sz * PIVOT_SAMPLES;
+		pivot_sample *samples = (pivot_sample*)malloc(n_samples * sizeof(pivot_sample));
+		size_t total = 0, target, below = 0;
+
+		for(i = 0; i < n_samples; ++i) {
+			int member = i / PIVOT_SAMPLES;
+
+			if(i % PIVOT_SAMPLES == 0) {
+				if(member > 0) {
+					MPI_Recv(keys, PIVOT_SAMPLES, MPI_INT, blockStart + member, 0, MPI_COMM_WORLD,
+						MPI_STATUS_IGNORE);
+					MPI_Recv(weights, PIVOT_SAMPLES, MPI_SIZE_T, blockStart + member, 0,
+						MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				}
+			}
+			samples[i].key = keys[i % PIVOT_SAMPLES];
+			samples[i].weight = weights[i % PIVOT_SAMPLES];
+			total += samples[i].weight;
+		}
+		qsort(samples, n_samples, sizeof(pivot_sample), sample_cmp);
+
+		//First sample whose elements reach past the target
+		target = (size_t)((double)total * (split - blockStart) / block_sz + 0.5);
+		for(i = 0; i < n_samples; ++i) {
+			if(samples[i].weight == 0) {
+				continue;
+			}
+			pivot = samples[i].key;
+			below += samples[i].weight;
+			if(below >= target) {
+				break;
+			}
+		}
+		free(samples);
+
+		for(i = blockStart+1; i < blockEnd; ++i) {
+			MPI_Send(&pivot, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+		}
+	}
+	else {
+		MPI_Send(keys, PIVOT_SAMPLES, MPI_INT, blockStart, 0, MPI_COMM_WORLD);
+		MPI_Send(weights, PIVOT_SAMPLES, MPI_SIZE_T, blockStart, 0, MPI_COMM_WORLD);
+		MPI_Recv(&pivot, 1, MPI_INT, blockStart, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	return pivot;
+}
+
+size_t split_ties(size_t lower, size_t equal, size_t size, int blockStart, int blockEnd,
+	int split, int my_rank) {
+	//Root sums the block's counts and hands every member its share of the equal keys to
+	//keep below the split, so the lower sub-block gets its part of all the block's keys
+	size_t counts[3] = {lower, equal, size}, take;
+
+	if(my_rank == blockStart) {
+		int block_sz = blockEnd - blockStart, i;
+		size_t *all_counts = (size_t*)malloc(3 * block_sz * sizeof(size_t));
+		size_t total_lower = 0, total_equal = 0, total = 0, target, wanted, before = 0;
+
+		memcpy(all_counts, counts, 3 * sizeof(size_t));
+		for(i = 1; i < block_sz; ++i) {
+			MPI_Recv(all_counts + 3*i, 3, MPI_SIZE_T, blockStart + i, 0, MPI_COMM_WORLD,
+				MPI_STATUS_IGNORE);
+		}
+		for(i = 0; i < block_sz; ++i) {
+			total_lower += all_counts[3*i];
+			total_equal += all_counts[3*i + 1];
+			total += all_counts[3*i + 2];
+		}
+
+		//Equal keys the lower sub-block needs to reach its share of the block
+		target = (size_t)((double)total * (split - blockStart) / block_sz + 0.5);
+		wanted = (target <= total_lower) ? 0 :
+			((target - total_lower < total_equal) ? target - total_lower : total_equal);
+
+		//Every member gives the same proportion of its equal keys, rounded so the shares
+		//add up to exactly wanted
+		for(i = 0; i < block_sz; ++i) {
+			size_t share = (total_equal == 0) ? 0 : (size_t)((double)(before +
+				all_counts[3*i + 1]) * wanted / total_equal + 0.5) -
+				(size_t)((double)before * wanted / total_equal + 0.5);
+
+			before += all_counts[3*i + 1];
+			if(i == 0) {
+				take = share;
+			}
+			else {
+				MPI_Send(&share, 1, MPI_SIZE_T, blockStart + i, 0, MPI_COMM_WORLD);
+			}
+		}
+
+		free(all_counts);
+	}
+	else {
+		MPI_Send(counts, 3, MPI_SIZE_T, blockStart, 0, MPI_COMM_WORLD);
+		MPI_Recv(&take, 1, MPI_SIZE_T, blockStart, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	return take;
+}
+
+void grow_lists(int *arr[], int *scratch[], int *merge_scratch[], size_t count,
+	size_t *capacity, size_t needed, arena *memory) {
+	if(needed <= *capacity) {
+		return;
+	}
+
+	//Outgrown buffers are only released with the arena; larger ones spill to the heap once
+	//the reservation is used up
+	int* grown = (int*)arena_alloc(memory, needed * sizeof(int));
+	memcpy(grown, *arr, count * sizeof(int));
+	*arr = grown;
+	*scratch = (int*)arena_alloc(memory, needed * sizeof(int));
+	*merge_scratch = (int*)arena_alloc(memory, needed * sizeof(int));
+	*capacity = needed;
+}
+
 int hcube_level(int start, int end) {
 	int level = 0;
 	int size = end - start - 1;
@@ -223,13 +431,17 @@ int hcube_level(int start, int end) {
 	return level - 1;
 }
 
-int median(int arr[], int size) {
-	if(size & 0x01) {
-		//Odd number size
-		return (arr[size/2] + arr[size/2 + 1])/2;
-	}
-	else {
-		//Even number size
-		return arr[size/2];
-	}
+int sample_cmp(const void *a, const void *b) {
+	int x = ((const pivot_sample*)a)->key, y = ((const pivot_sample*)b)->key;
+
+	return (x > y) - (x < y);
+}
+
+#ifdef SORT_KERNELS
+#include "kernels.h"
+
+size_t kernel_hqs_merge(int in_result[], size_t start, size_t stop, int in_scratch[],
+	size_t scratch_size, int merge_scratch[]) {
+	return merge(in_result, start, stop, in_scratch, scratch_size, merge_scratch);
 }
+#endif
@@ -2,4 +2,10 @@
 
 #include <stddef.h>
 
+//Each block picks its pivot from regular samples of all its members and splits keys equal
+//to the pivot over the whole block, so heavy keys do not skew the partitions.
+//With a stream sink enabled the sorted list goes to its callback and arr is left as is
 void hyper_qsort(int arr[], size_t size, int my_rank, int comm_sz);
+
+//Largest list any process held after the last hyper_qsort() exchange, before rebalancing
+size_t hyper_qsort_max_partition(void);
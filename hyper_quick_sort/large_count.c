@@ -0,0 +1,335 @@
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#if MPI_VERSION >= 4
+
+void lc_send(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm) {
+	MPI_Send_c(buf, count, type, dest, tag, comm);
+}
+
+void lc_recv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Status *status) {
+	MPI_Recv_c(buf, count, type, source, tag, comm, status);
+}
+
+void lc_isend(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm, MPI_Request *request) {
+	MPI_Isend_c(buf, count, type, dest, tag, comm, request);
+}
+
+void lc_irecv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Request *request) {
+	MPI_Irecv_c(buf, count, type, source, tag, comm, request);
+}
+
+void lc_mrecv(void *buf, size_t count, MPI_Datatype type, MPI_Message *message,
+	MPI_Status *status) {
+	MPI_Mrecv_c(buf, count, type, message, status);
+}
+
+size_t lc_get_count(MPI_Status *status, MPI_Datatype type) {
+	MPI_Count count;
+
+	MPI_Get_count_c(status, type, &count);
+
+	return count;
+}
+
+void lc_gatherv(const void *send_buf, size_t send_count, void *recv_buf,
+	const size_t recv_counts[], const size_t displs[], MPI_Datatype type, int root,
+	MPI_Comm comm) {
+	MPI_Count *counts = NULL;
+	MPI_Aint *offsets = NULL;
+	int my_rank, comm_sz, i;
+
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+
+	if(my_rank == root) {
+		counts = (MPI_Count*)malloc(comm_sz * sizeof(MPI_Count));
+		offsets = (MPI_Aint*)malloc(comm_sz * sizeof(MPI_Aint));
+		for(i = 0; i < comm_sz; ++i) {
+			counts[i] = recv_counts[i];
+			offsets[i] = displs[i];
+		}
+	}
+
+	MPI_Gatherv_c(send_buf, send_count, type, recv_buf, counts, offsets, type, root, comm);
+
+	free(counts);
+	free(offsets);
+}
+
+void lc_alltoallv(const void *send_buf, const size_t send_counts[],
+	const size_t send_displs[], void *recv_buf, const size_t recv_counts[],
+	const size_t recv_displs[], MPI_Datatype type, MPI_Comm comm) {
+	MPI_Count *s_counts, *r_counts;
+	MPI_Aint *s_displs, *r_displs;
+	int comm_sz, i;
+
+	MPI_Comm_size(comm, &comm_sz);
+	s_counts = (MPI_Count*)malloc(comm_sz * sizeof(MPI_Count));
+	r_counts = (MPI_Count*)malloc(comm_sz * sizeof(MPI_Count));
+	s_displs = (MPI_Aint*)malloc(comm_sz * sizeof(MPI_Aint));
+	r_displs = (MPI_Aint*)malloc(comm_sz * sizeof(MPI_Aint));
+	for(i = 0; i < comm_sz; ++i) {
+		s_counts[i] = send_counts[i];
+		r_counts[i] = recv_counts[i];
+		s_displs[i] = send_displs[i];
+		r_displs[i] = recv_displs[i];
+	}
+
+	MPI_Alltoallv_c(send_buf, s_counts, s_displs, type, recv_buf, r_counts, r_displs, type,
+		comm);
+
+	free(s_counts);
+	free(r_counts);
+	free(s_displs);
+	free(r_displs);
+}
+
+#else
+
+//Blocks of this many elements make up the derived type of a large message
+#define LC_BLOCK		(1 << 30)
+
+static void large_type(size_t count, MPI_Datatype type, MPI_Datatype *lc_type,
+	int *lc_count);
+static void free_type(MPI_Datatype *lc_type, MPI_Datatype type);
+static int fits_int(const size_t counts[], const size_t displs[], int n);
+
+void lc_send(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm) {
+	MPI_Datatype send_type;
+	int send_count;
+
+	large_type(count, type, &send_type, &send_count);
+	MPI_Send(buf, send_count, send_type, dest, tag, comm);
+	free_type(&send_type, type);
+}
+
+void lc_recv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Status *status) {
+	MPI_Datatype recv_type;
+	int recv_count;
+
+	large_type(count, type, &recv_type, &recv_count);
+	MPI_Recv(buf, recv_count, recv_type, source, tag, comm, status);
+	free_type(&recv_type, type);
+}
+
+void lc_isend(const void *buf, size_t count, MPI_Datatype type, int dest, int tag,
+	MPI_Comm comm, MPI_Request *request) {
+	MPI_Datatype send_type;
+	int send_count;
+
+	large_type(count, type, &send_type, &send_count);
+	MPI_Isend(buf, send_count, send_type, dest, tag, comm, request);
+	free_type(&send_type, type);
+}
+
+void lc_irecv(void *buf, size_t count, MPI_Datatype type, int source, int tag,
+	MPI_Comm comm, MPI_Request *request) {
+	MPI_Datatype recv_type;
+	int recv_count;
+
+	large_type(count, type, &recv_type, &recv_count);
+	MPI_Irecv(buf, recv_count, recv_type, source, tag, comm, request);
+	free_type(&recv_type, type);
+}
+
+void lc_mrecv(void *buf, size_t count, MPI_Datatype type, MPI_Message *message,
+	MPI_Status *status) {
+	MPI_Datatype recv_type;
+	int recv_count;
+
+	large_type(count, type, &recv_type, &recv_count);
+	MPI_Mrecv(buf, recv_count, recv_type, message, status);
+	free_type(&recv_type, type);
+}
+
+size_t lc_get_count(MPI_Status *status, MPI_Datatype type) {
+	MPI_Count count;
+
+	//Counts basic elements, so it works whatever derived type the sender used
+	MPI_Get_elements_x(status, type, &count);
+
+	return count;
+}
+
+void lc_gatherv(const void *send_buf, size_t send_count, void *recv_buf,
+	const size_t recv_counts[], const size_t displs[], MPI_Datatype type, int root,
+	MPI_Comm comm) {
+	int my_rank, comm_sz, fits = 1, i;
+
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+
+	//Only root knows the counts, so it decides which path everyone takes
+	if(my_rank == root) {
+		fits = fits_int(recv_counts, displs, comm_sz);
+	}
+	MPI_Bcast(&fits, 1, MPI_INT, root, comm);
+
+	if(fits) {
+		int *counts = NULL, *offsets = NULL;
+
+		if(my_rank == root) {
+			counts = (int*)malloc(comm_sz * sizeof(int));
+			offsets = (int*)malloc(comm_sz * sizeof(int));
+			for(i = 0; i < comm_sz; ++i) {
+				counts[i] = recv_counts[i];
+				offsets[i] = displs[i];
+			}
+		}
+
+		MPI_Gatherv(send_buf, send_count, type, recv_buf, counts, offsets, type, root, comm);
+
+		free(counts);
+		free(offsets);
+	}
+	else if(my_rank == root) {
+		MPI_Request *requests = (MPI_Request*)malloc(comm_sz * sizeof(MPI_Request));
+		MPI_Aint lb, extent;
+
+		MPI_Type_get_extent(type, &lb, &extent);
+		for(i = 0; i < comm_sz; ++i) {
+			MPI_Datatype recv_type;
+			int recv_count;
+
+			if(i == root) {
+				memcpy((char*)recv_buf + displs[i] * extent, send_buf, send_count * extent);
+				requests[i] = MPI_REQUEST_NULL;
+				continue;
+			}
+
+			large_type(recv_counts[i], type, &recv_type, &recv_count);
+			MPI_Irecv((char*)recv_buf + displs[i] * extent, recv_count, recv_type, i, 0, comm,
+				&requests[i]);
+			free_type(&recv_type, type);
+		}
+		MPI_Waitall(comm_sz, requests, MPI_STATUSES_IGNORE);
+
+		free(requests);
+	}
+	else {
+		lc_send(send_buf, send_count, type, root, 0, comm);
+	}
+}
+
+void lc_alltoallv(const void *send_buf, const size_t send_counts[],
+	const size_t send_displs[], void *recv_buf, const size_t recv_counts[],
+	const size_t recv_displs[], MPI_Datatype type, MPI_Comm comm) {
+	int comm_sz, fits, all_fit, i;
+
+	MPI_Comm_size(comm, &comm_sz);
+
+	fits = fits_int(send_counts, send_displs, comm_sz) &&
+		fits_int(recv_counts, recv_displs, comm_sz);
+	MPI_Allreduce(&fits, &all_fit, 1, MPI_INT, MPI_LAND, comm);
+
+	if(all_fit) {
+		int *s_counts = (int*)malloc(comm_sz * sizeof(int)),
+			*r_counts = (int*)malloc(comm_sz * sizeof(int)),
+			*s_displs = (int*)malloc(comm_sz * sizeof(int)),
+			*r_displs = (int*)malloc(comm_sz * sizeof(int));
+
+		for(i = 0; i < comm_sz; ++i) {
+			s_counts[i] = send_counts[i];
+			r_counts[i] = recv_counts[i];
+			s_displs[i] = send_displs[i];
+			r_displs[i] = recv_displs[i];
+		}
+
+		MPI_Alltoallv(send_buf, s_counts, s_displs, type, recv_buf, r_counts, r_displs, type,
+			comm);
+
+		free(s_counts);
+		free(r_counts);
+		free(s_displs);
+		free(r_displs);
+	}
+	else {
+		//Pairwise messages, each of which may hold more than INT_MAX elements
+		MPI_Request *requests = (MPI_Request*)malloc(2 * comm_sz * sizeof(MPI_Request));
+		MPI_Aint lb, extent;
+
+		MPI_Type_get_extent(type, &lb, &extent);
+		for(i = 0; i < comm_sz; ++i) {
+			MPI_Datatype lc_type;
+			int lc_count;
+
+			large_type(recv_counts[i], type, &lc_type, &lc_count);
+			MPI_Irecv((char*)recv_buf + recv_displs[i] * extent, lc_count, lc_type, i, 0, comm,
+				&requests[i]);
+			free_type(&lc_type, type);
+
+			large_type(send_counts[i], type, &lc_type, &lc_count);
+			MPI_Isend((const char*)send_buf + send_displs[i] * extent, lc_count, lc_type, i, 0,
+				comm, &requests[comm_sz + i]);
+			free_type(&lc_type, type);
+		}
+		MPI_Waitall(2 * comm_sz, requests, MPI_STATUSES_IGNORE);
+
+		free(requests);
+	}
+}
+
+void large_type(size_t count, MPI_Datatype type, MPI_Datatype *lc_type, int *lc_count) {
+	MPI_Datatype block_type, blocks_type;
+	size_t blocks = count / LC_BLOCK, remainder = count % LC_BLOCK;
+
+	if(count <= INT_MAX) {
+		*lc_type = type;
+		*lc_count = count;
+		return;
+	}
+
+	MPI_Type_contiguous(LC_BLOCK, type, &block_type);
+	MPI_Type_contiguous(blocks, block_type, &blocks_type);
+
+	if(remainder > 0) {
+		//Whole blocks followed by the remaining elements
+		MPI_Aint lb, extent, displs[2];
+		MPI_Datatype types[2] = {blocks_type, type};
+		int lengths[2] = {1, remainder};
+
+		MPI_Type_get_extent(type, &lb, &extent);
+		displs[0] = 0;
+		displs[1] = (MPI_Aint)blocks * LC_BLOCK * extent;
+		MPI_Type_create_struct(2, lengths, displs, types, lc_type);
+		MPI_Type_free(&blocks_type);
+	}
+	else {
+		*lc_type = blocks_type;
+	}
+
+	MPI_Type_commit(lc_type);
+	MPI_Type_free(&block_type);
+	*lc_count = 1;
+}
+
+void free_type(MPI_Datatype *lc_type, MPI_Datatype type) {
+	//Pending operations keep their own reference to the type
+	if(*lc_type != type) {
+		MPI_Type_free(lc_type);
+	}
+}
+
+int fits_int(const size_t counts[], const size_t displs[], int n) {
+	int i;
+
+	for(i = 0; i < n; ++i) {
+		if((counts[i] > INT_MAX) || (displs[i] > INT_MAX)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+#endif
@@ -3,8 +3,16 @@
 #include <mpi.h> 
 
 #include "hyper_qsort.h"
+#include "wire_codec.h"
+#include "stream_sink.h"
+#include "presort.h"
+#include "rebalance.h"
 
 #define ARRAY_SIZE		1024
+#define WIRE_CODEC		1
+#define STREAM_CHUNK	100
+#define STREAM_FILE		"sorted.bin"
+#define MAX_IMBALANCE	0.1
 
 void print_array(int* arr, size_t size);
 
@@ -15,6 +23,8 @@ int main(void) {
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
 
+	wire_codec_enable(WIRE_CODEC);
+
 	int* arr;
 	if(my_rank == 0) {
 		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
@@ -38,6 +48,103 @@ int main(void) {
 		//free(arr);
 	}
 
+	//Stream the sorted output straight into a file on rank 0
+	FILE *file = NULL;
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+		file = fopen(STREAM_FILE, "wb");
+	}
+
+	stream_sink_enable(stream_write_file, file, STREAM_CHUNK, 0);
+	hyper_qsort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	stream_sink_enable(NULL, NULL, 0, 0);
+
+	if(my_rank == 0) {
+		fclose(file);
+
+		file = fopen(STREAM_FILE, "rb");
+		size_t read = fread(arr, sizeof(int), ARRAY_SIZE, file);
+		fclose(file);
+		remove(STREAM_FILE);
+
+		if((read == ARRAY_SIZE) && validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Streaming validation successful!\n");
+		}
+		else {
+			printf("[Error] Streaming validation not successful :(\n");
+		}
+	}
+
+	//Already sorted input skips the hypercube exchanges
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = i;
+		}
+	}
+
+	presort_enable(1);
+	hyper_qsort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	presort_enable(0);
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE) && presort_last_path().in_order) {
+			printf("[Info] Presorted validation successful!\n");
+		}
+		else {
+			printf("[Error] Presorted validation not successful :(\n");
+		}
+	}
+
+	//Chunks of odd processes hold nothing but one key, which the pivots of every block must
+	//split to keep the partitions even
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = ((i * comm_sz / ARRAY_SIZE) % 2) ? 7 : rand() % 100;
+		}
+	}
+
+	hyper_qsort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	size_t max_count = hyper_qsort_max_partition(),
+		bound = (size_t)((1 + MAX_IMBALANCE) * ARRAY_SIZE / comm_sz) + 1;
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE) && (max_count <= bound)) {
+			printf("[Info] Heavy key validation successful (%zu <= %zu)!\n", max_count, bound);
+		}
+		else {
+			printf("[Error] Heavy key validation not successful (%zu > %zu) :(\n", max_count,
+				bound);
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+
+	//Even out partitions skewed by one frequent key before the gather
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = (i % 2) ? 7 : rand() % 100;
+		}
+	}
+
+	rebalance_enable(1);
+	hyper_qsort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	rebalance_enable(0);
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Rebalance validation successful!\n");
+		}
+		else {
+			printf("[Error] Rebalance validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+
    MPI_Finalize();
    return 0;
 }  /* main */
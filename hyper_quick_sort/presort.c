@@ -0,0 +1,149 @@
+#include "presort.h"
+#include "serial_qsort.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+static int ranks_ordered(int nonempty, int min, int max, MPI_Comm comm);
+static void reverse(int arr[], size_t count);
+static void merge_runs(int arr[], size_t count, size_t runs);
+static void merge(const int a[], size_t a_count, const int b[], size_t b_count, int out[]);
+
+static int presort = 0;
+static presort_path last_path = {PRESORT_LOCAL_QSORT, 0};
+
+void presort_enable(int enable) {
+	presort = enable;
+}
+
+int presort_enabled(void) {
+	return presort;
+}
+
+int presort_sort(int arr[], size_t count, MPI_Comm comm) {
+	size_t descents = 0, ascents = 0, i;
+	int min = INT_MAX, max = INT_MIN;
+
+	//One pass for run structure and key range
+	for(i = 0; i < count; ++i) {
+		if(i > 0) {
+			descents += arr[i] < arr[i-1];
+			ascents += arr[i] > arr[i-1];
+		}
+		min = (arr[i] < min) ? arr[i] : min;
+		max = (arr[i] > max) ? arr[i] : max;
+	}
+
+	last_path.in_order = ranks_ordered(count > 0, min, max, comm);
+
+	if(descents == 0) {
+		last_path.local = PRESORT_LOCAL_SORTED;
+	}
+	else if(ascents == 0) {
+		last_path.local = PRESORT_LOCAL_REVERSED;
+		reverse(arr, count);
+	}
+	else if(descents < PRESORT_MAX_RUNS) {
+		last_path.local = PRESORT_LOCAL_RUNS;
+		merge_runs(arr, count, descents + 1);
+	}
+	else {
+		last_path.local = PRESORT_LOCAL_QSORT;
+		serial_qsort(arr, count);
+	}
+
+	return last_path.in_order;
+}
+
+presort_path presort_last_path(void) {
+	return last_path;
+}
+
+int ranks_ordered(int nonempty, int min, int max, MPI_Comm comm) {
+	int range[3] = {nonempty, min, max}, *ranges, comm_sz, prev_max = INT_MIN, ordered = 1;
+	int i;
+
+	MPI_Comm_size(comm, &comm_sz);
+	ranges = (int*)malloc(3 * comm_sz * sizeof(int));
+	MPI_Allgather(range, 3, MPI_INT, ranges, 3, MPI_INT, comm);
+
+	//Every non-empty list must start at or after the end of the lists before it
+	for(i = 0; i < comm_sz; ++i) {
+		if(!ranges[3*i]) {
+			continue;
+		}
+		if(ranges[3*i + 1] < prev_max) {
+			ordered = 0;
+			break;
+		}
+		prev_max = ranges[3*i + 2];
+	}
+
+	free(ranges);
+
+	return ordered;
+}
+
+void reverse(int arr[], size_t count) {
+	size_t i;
+
+	for(i = 0; i < count/2; ++i) {
+		int tmp = arr[i];
+		arr[i] = arr[count - 1 - i];
+		arr[count - 1 - i] = tmp;
+	}
+}
+
+void merge_runs(int arr[], size_t count, size_t runs) {
+	size_t *bounds = (size_t*)malloc((runs + 1) * sizeof(size_t)), n_bounds = 1, i;
+	int *scratch = (int*)malloc(count * sizeof(int)), *src = arr, *dst = scratch;
+
+	bounds[0] = 0;
+	for(i = 1; i < count; ++i) {
+		if(arr[i] < arr[i-1]) {
+			bounds[n_bounds++] = i;
+		}
+	}
+	bounds[runs] = count;
+
+	//Bottom-up pairwise merging, alternating between arr and scratch
+	while(runs > 1) {
+		size_t merged = 0, r;
+
+		for(r = 0; r < runs; r += 2) {
+			if(r + 1 < runs) {
+				merge(src + bounds[r], bounds[r+1] - bounds[r], src + bounds[r+1],
+					bounds[r+2] - bounds[r+1], dst + bounds[r]);
+			}
+			else {
+				memcpy(dst + bounds[r], src + bounds[r], (bounds[r+1] - bounds[r]) * sizeof(int));
+			}
+			bounds[merged++] = bounds[r];
+		}
+		bounds[merged] = count;
+		runs = merged;
+
+		int *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if(src != arr) {
+		memcpy(arr, src, count * sizeof(int));
+	}
+
+	free(bounds);
+	free(scratch);
+}
+
+void merge(const int a[], size_t a_count, const int b[], size_t b_count, int out[]) {
+	size_t i_a = 0, i_b = 0, i_out = 0;
+
+	while((i_a < a_count) && (i_b < b_count)) {
+		out[i_out++] = (b[i_b] < a[i_a]) ? b[i_b++] : a[i_a++];
+	}
+	memcpy(out + i_out, a + i_a, (a_count - i_a) * sizeof(int));
+	i_out += a_count - i_a;
+	memcpy(out + i_out, b + i_b, (b_count - i_b) * sizeof(int));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <mpi.h>
+
+//Optional pre-pass before the local sort. One scan classifies the local list and finds
+//its min and max, and one MPI_Allgather of those tells whether the lists are already in
+//rank order, in which case the engines skip their redistribution.
+
+//Lists of up to this many sorted runs are merged instead of sorted from scratch
+#define PRESORT_MAX_RUNS	16
+
+//How the local list was sorted
+typedef enum {
+	PRESORT_LOCAL_SORTED,		//Already sorted, left as is
+	PRESORT_LOCAL_REVERSED,		//Non-increasing, reversed in place
+	PRESORT_LOCAL_RUNS,			//A few sorted runs, merged pairwise
+	PRESORT_LOCAL_QSORT			//Full serial_qsort
+} presort_local;
+
+typedef struct {
+	presort_local local;
+	int in_order;				//Lists were in rank order, redistribution skipped
+} presort_path;
+
+void presort_enable(int enable);
+int presort_enabled(void);
+
+//Collective: sorts the local list and returns whether the sorted lists are already in
+//global rank order
+int presort_sort(int arr[], size_t count, MPI_Comm comm);
+
+//Path taken by the last presort_sort() call on this process
+presort_path presort_last_path(void);
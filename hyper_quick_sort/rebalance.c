@@ -0,0 +1,125 @@
+#include "rebalance.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define REBALANCE_TAG		1
+
+//Slice of the target range sent by one process
+typedef struct {
+	MPI_Message message;	//MPI_MESSAGE_NULL for the slice this process keeps
+	int source;
+	size_t count;
+} piece;
+
+static size_t range_start(int rank, size_t total, int comm_sz);
+static int piece_cmp(const void *a, const void *b);
+
+static int rebalance_on = 0;
+
+void rebalance_enable(int enable) {
+	rebalance_on = enable;
+}
+
+int rebalance_enabled(void) {
+	return rebalance_on;
+}
+
+size_t rebalance(int arr[], size_t count, int out[], MPI_Comm parent) {
+	size_t offset = 0, total, my_start, my_end, received = 0;
+	int my_rank, comm_sz, n_requests = 0, n_pieces = 0, *kept = NULL, dest, i;
+	MPI_Request *requests;
+	MPI_Comm comm;
+	piece *pieces;
+
+	//Slices are matched from any source, so they travel on a private communicator where
+	//no other module's messages can be in flight
+	MPI_Comm_dup(parent, &comm);
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+	requests = (MPI_Request*)malloc(comm_sz * sizeof(MPI_Request));
+	pieces = (piece*)malloc(comm_sz * sizeof(piece));
+
+	//Global position of this list; the exclusive scan leaves rank 0 undefined
+	MPI_Exscan(&count, &offset, 1, MPI_SIZE_T, MPI_SUM, comm);
+	if(my_rank == 0) {
+		offset = 0;
+	}
+	MPI_Allreduce(&count, &total, 1, MPI_SIZE_T, MPI_SUM, comm);
+
+	my_start = range_start(my_rank, total, comm_sz);
+	my_end = range_start(my_rank + 1, total, comm_sz);
+
+	//Send each overlap of this list with a target range, starting at the owner of offset
+	if(count > 0) {
+		dest = offset * comm_sz / total;
+		while(range_start(dest + 1, total, comm_sz) <= offset) {
+			dest++;
+		}
+		for(; (dest < comm_sz) && (range_start(dest, total, comm_sz) < offset + count);
+			++dest) {
+			size_t start = range_start(dest, total, comm_sz),
+				end = range_start(dest + 1, total, comm_sz);
+
+			start = (start > offset) ? start : offset;
+			end = (end < offset + count) ? end : offset + count;
+			if(end <= start) {
+				//Empty target range, only possible with fewer elements than processes
+				continue;
+			}
+
+			if(dest == my_rank) {
+				kept = arr + (start - offset);
+				pieces[n_pieces].message = MPI_MESSAGE_NULL;
+				pieces[n_pieces].source = my_rank;
+				pieces[n_pieces++].count = end - start;
+				received += end - start;
+			}
+			else {
+				lc_isend(arr + (start - offset), end - start, MPI_INT, dest, REBALANCE_TAG,
+					comm, &requests[n_requests++]);
+			}
+		}
+	}
+
+	//Senders are unknown, so match slices as they arrive until the range is covered
+	while(received < my_end - my_start) {
+		MPI_Status status;
+
+		MPI_Mprobe(MPI_ANY_SOURCE, REBALANCE_TAG, comm, &pieces[n_pieces].message, &status);
+		pieces[n_pieces].source = status.MPI_SOURCE;
+		pieces[n_pieces].count = lc_get_count(&status, MPI_INT);
+		received += pieces[n_pieces++].count;
+	}
+
+	//Lower ranks hold the lower part of the range
+	qsort(pieces, n_pieces, sizeof(piece), piece_cmp);
+	received = 0;
+	for(i = 0; i < n_pieces; ++i) {
+		if(pieces[i].source == my_rank) {
+			memcpy(out + received, kept, pieces[i].count * sizeof(int));
+		}
+		else {
+			lc_mrecv(out + received, pieces[i].count, MPI_INT, &pieces[i].message,
+				MPI_STATUS_IGNORE);
+		}
+		received += pieces[i].count;
+	}
+
+	MPI_Waitall(n_requests, requests, MPI_STATUSES_IGNORE);
+	MPI_Comm_free(&comm);
+
+	free(requests);
+	free(pieces);
+
+	return received;
+}
+
+size_t range_start(int rank, size_t total, int comm_sz) {
+	return rank * total / comm_sz;
+}
+
+int piece_cmp(const void *a, const void *b) {
+	return ((const piece*)a)->source - ((const piece*)b)->source;
+}
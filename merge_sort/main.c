@@ -3,8 +3,10 @@
 #include <mpi.h> 
 
 #include "merge_sort.h"
+#include "wire_codec.h"
 
 #define ARRAY_SIZE		1024
+#define WIRE_CODEC		1
 
 void print_array(int* arr, size_t size);
 
@@ -15,6 +17,8 @@ int main(void) {
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
 
+	wire_codec_enable(WIRE_CODEC);
+
 	int* arr;
 	if(my_rank == 0) {
 		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
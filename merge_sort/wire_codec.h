@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <mpi.h>
+
+//Sorted runs are sent as a zigzag first value followed by varint coded gaps. Runs that
+//are unsorted or compress poorly fall back to raw ints, so either form may arrive.
+
+//Worst case encoded size of a run of count ints
+#define wire_encode_bound(count)	(1 + (size_t)(count) * sizeof(int) + 10)
+
+//Returned by wire_decode() when the run does not fit into capacity ints
+#define WIRE_OVERFLOW				((size_t)-1)
+
+void wire_codec_enable(int enable);
+int wire_codec_enabled(void);
+
+size_t wire_encode(const int run[], size_t count, unsigned char buf[]);
+size_t wire_decode(const unsigned char buf[], size_t bytes, int run[], size_t capacity);
+
+//With the codec disabled runs travel as plain ints. Every process must use the same
+//setting. wire_recv() fails if the run holds more than capacity ints.
+void wire_send(const int run[], size_t count, int dest, int tag, MPI_Comm comm);
+size_t wire_recv(int run[], size_t capacity, int source, int tag, MPI_Comm comm,
+	MPI_Status *status);
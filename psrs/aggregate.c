@@ -0,0 +1,208 @@
+#include "aggregate.h"
+#include "large_count.h"
+
+#include <stdlib.h>
+
+#define AGGREGATE_TAG		2
+
+//Last run of the lists of a range of processes
+typedef struct {
+	int key;
+	int rank;			//Last process in the range holding elements, -1 if none does
+	int uniform;		//Run covers every element of the range
+	size_t count;
+	int64_t sum;
+} agg_tail;
+
+static int fix_boundaries(agg_group *head, const agg_group *tail, int uniform,
+	MPI_Comm comm);
+static void tail_op(void *in, void *inout, int *len, MPI_Datatype *type);
+static MPI_Datatype tail_type(void);
+static MPI_Datatype group_type(void);
+
+size_t aggregate_groups(const int arr[], const int values[], size_t count,
+	agg_group groups[], MPI_Comm comm) {
+	size_t n_groups = 0, i;
+
+	//Run-length reduce the local list
+	for(i = 0; i < count; ++i) {
+		int64_t value = (values == NULL) ? arr[i] : values[i];
+
+		if((n_groups > 0) && (groups[n_groups-1].key == arr[i])) {
+			groups[n_groups-1].count++;
+			groups[n_groups-1].sum += value;
+		}
+		else {
+			groups[n_groups].key = arr[i];
+			groups[n_groups].count = 1;
+			groups[n_groups].sum = value;
+			n_groups++;
+		}
+	}
+
+	if(fix_boundaries((count > 0) ? &groups[0] : NULL,
+		(count > 0) ? &groups[n_groups-1] : NULL, n_groups == 1, comm)) {
+		n_groups--;
+	}
+
+	return n_groups;
+}
+
+size_t aggregate_unique(int arr[], size_t count, MPI_Comm comm) {
+	agg_group head, tail;
+	size_t n_keys = 0, i;
+
+	for(i = 0; i < count; ++i) {
+		if((n_keys == 0) || (arr[n_keys-1] != arr[i])) {
+			arr[n_keys++] = arr[i];
+		}
+	}
+
+	//Counts do not matter here, only which process keeps a boundary key
+	if(count > 0) {
+		head.key = arr[0];
+		tail.key = arr[n_keys-1];
+		head.count = tail.count = 0;
+		head.sum = tail.sum = 0;
+	}
+	if(fix_boundaries((count > 0) ? &head : NULL, (count > 0) ? &tail : NULL, n_keys == 1,
+		comm)) {
+		n_keys--;
+	}
+
+	return n_keys;
+}
+
+agg_group *aggregate_gather(const agg_group groups[], size_t count, size_t *total, int root,
+	MPI_Comm comm) {
+	MPI_Datatype type = group_type();
+	agg_group *all_groups = NULL;
+	size_t *counts = NULL, *displs = NULL;
+	int my_rank, comm_sz, i;
+
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+
+	if(my_rank == root) {
+		counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&count, 1, MPI_SIZE_T, counts, 1, MPI_SIZE_T, root, comm);
+
+	if(my_rank == root) {
+		*total = 0;
+		for(i = 0; i < comm_sz; ++i) {
+			displs[i] = *total;
+			*total += counts[i];
+		}
+		all_groups = (agg_group*)malloc((*total + 1) * sizeof(agg_group));
+	}
+
+	//Processes own consecutive key ranges, so rank order is key order
+	lc_gatherv(groups, count, all_groups, counts, displs, type, root, comm);
+
+	MPI_Type_free(&type);
+	free(counts);
+	free(displs);
+
+	return all_groups;
+}
+
+int fix_boundaries(agg_group *head, const agg_group *tail, int uniform, MPI_Comm parent) {
+	MPI_Datatype type = tail_type();
+	MPI_Comm comm;
+	MPI_Op op;
+	agg_tail mine = {0, -1, 0, 0, 0}, before;
+	int my_rank, comm_sz, last = -1, next_key, dest, source;
+
+	//The next key is received from any source, so it travels on a private communicator
+	//where no other module's messages can be in flight
+	MPI_Comm_dup(parent, &comm);
+	MPI_Comm_rank(comm, &my_rank);
+	MPI_Comm_size(comm, &comm_sz);
+
+	if(head != NULL) {
+		mine.rank = my_rank;
+		mine.uniform = uniform;
+		mine.key = tail->key;
+		mine.count = tail->count;
+		mine.sum = tail->sum;
+	}
+
+	//Last run of all lower ranks, so a key spanning several processes is carried to the
+	//last of them; the exclusive scan leaves rank 0 undefined
+	MPI_Op_create(tail_op, 0, &op);
+	MPI_Exscan(&mine, &before, 1, type, op, comm);
+	MPI_Op_free(&op);
+	MPI_Type_free(&type);
+	if(my_rank == 0) {
+		before.rank = -1;
+	}
+
+	//Last non-empty process has no right neighbour to hear from
+	MPI_Allreduce(&mine.rank, &last, 1, MPI_INT, MPI_MAX, comm);
+	if(head == NULL) {
+		MPI_Comm_free(&comm);
+		return 0;
+	}
+
+	if((before.rank >= 0) && (before.key == head->key)) {
+		head->count += before.count;
+		head->sum += before.sum;
+	}
+
+	//Send the first key to the previous non-empty process, receive the next one's
+	dest = (before.rank >= 0) ? before.rank : MPI_PROC_NULL;
+	source = (my_rank < last) ? MPI_ANY_SOURCE : MPI_PROC_NULL;
+	MPI_Sendrecv(&head->key, 1, MPI_INT, dest, AGGREGATE_TAG, &next_key, 1, MPI_INT, source,
+		AGGREGATE_TAG, comm, MPI_STATUS_IGNORE);
+	MPI_Comm_free(&comm);
+
+	return (source != MPI_PROC_NULL) && (next_key == tail->key);
+}
+
+void tail_op(void *in, void *inout, int *len, MPI_Datatype *type) {
+	agg_tail *left = (agg_tail*)in, *right = (agg_tail*)inout;
+	int i;
+
+	for(i = 0; i < *len; ++i) {
+		if(right[i].rank < 0) {
+			right[i] = left[i];
+		}
+		else if((left[i].rank >= 0) && right[i].uniform && (left[i].key == right[i].key)) {
+			//Run continues from the left range through the whole right one
+			right[i].count += left[i].count;
+			right[i].sum += left[i].sum;
+			right[i].uniform = left[i].uniform;
+		}
+	}
+}
+
+MPI_Datatype tail_type(void) {
+	int lengths[5] = {1, 1, 1, 1, 1};
+	MPI_Aint displs[5] = {offsetof(agg_tail, key), offsetof(agg_tail, rank),
+		offsetof(agg_tail, uniform), offsetof(agg_tail, count), offsetof(agg_tail, sum)};
+	MPI_Datatype types[5] = {MPI_INT, MPI_INT, MPI_INT, MPI_SIZE_T, MPI_INT64_T},
+		struct_type, type;
+
+	MPI_Type_create_struct(5, lengths, displs, types, &struct_type);
+	MPI_Type_create_resized(struct_type, 0, sizeof(agg_tail), &type);
+	MPI_Type_commit(&type);
+	MPI_Type_free(&struct_type);
+
+	return type;
+}
+
+MPI_Datatype group_type(void) {
+	int lengths[3] = {1, 1, 1};
+	MPI_Aint displs[3] = {offsetof(agg_group, key), offsetof(agg_group, count),
+		offsetof(agg_group, sum)};
+	MPI_Datatype types[3] = {MPI_INT, MPI_SIZE_T, MPI_INT64_T}, struct_type, type;
+
+	MPI_Type_create_struct(3, lengths, displs, types, &struct_type);
+	MPI_Type_create_resized(struct_type, 0, sizeof(agg_group), &type);
+	MPI_Type_commit(&type);
+	MPI_Type_free(&struct_type);
+
+	return type;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mpi.h>
+
+//Fused operators on a sorted list distributed in rank order over comm, like the lists of
+//psrs_dist before the gather. Every process run-length reduces its own list, an exclusive
+//scan carries the counts of keys spanning several processes and one MPI_Sendrecv between
+//neighbouring non-empty processes tells each whether its last key continues to the right.
+//Every key then belongs to exactly one process, the last one holding it. The neighbour
+//exchange runs on a duplicate of comm, so it cannot match other traffic.
+
+//Distinct key with the number of its elements and the sum of their values
+typedef struct {
+	int key;
+	size_t count;
+	int64_t sum;
+} agg_group;
+
+//Collective: reduces arr to one group per distinct key into groups, which needs room for
+//count entries. values, parallel to arr, may be NULL to sum the keys themselves.
+//Returns the number of groups this process owns.
+size_t aggregate_groups(const int arr[], const int values[], size_t count,
+	agg_group groups[], MPI_Comm comm);
+
+//Collective: removes duplicate keys from arr in place. Returns the number of keys this
+//process owns; stream_sorted() can send them on to a writer.
+size_t aggregate_unique(int arr[], size_t count, MPI_Comm comm);
+
+//Collective: gathers the distributed groups at root in key order. Returns a malloced
+//array at root and NULL elsewhere; total is set on root only.
+agg_group *aggregate_gather(const agg_group groups[], size_t count, size_t *total, int root,
+	MPI_Comm comm);
@@ -0,0 +1,128 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <mpi.h>
+
+#define ARENA_HUGE_PAGE		(2 << 20)
+
+struct arena_block {
+	arena_block *next;
+	size_t pad;				//Keeps the data behind the header 16 byte aligned
+};
+
+static size_t round_up(size_t value, size_t align);
+static void first_touch(char *start, size_t bytes);
+
+void arena_init(arena *scratch, size_t size) {
+	scratch->size = round_up(size, ARENA_ALIGN);
+	scratch->used = 0;
+	scratch->touched = 0;
+	scratch->overflow = NULL;
+	scratch->map_size = 0;
+
+	//Reservations smaller than a huge page gain nothing from one, so they only align to a
+	//cache line
+	if(scratch->size < ARENA_HUGE_PAGE) {
+		MPI_Alloc_mem(scratch->size + ARENA_ALIGN, MPI_INFO_NULL, &scratch->alloc);
+		scratch->base = (char*)round_up((uintptr_t)scratch->alloc, ARENA_ALIGN);
+		return;
+	}
+
+#ifdef MAP_HUGETLB
+	//Explicit huge pages, only available if the administrator reserved some. Without
+	//MAP_NORESERVE the whole range would be taken from the pool up front
+	scratch->map_size = round_up(scratch->size, ARENA_HUGE_PAGE);
+	scratch->alloc = mmap(NULL, scratch->map_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_NORESERVE, -1, 0);
+	if(scratch->alloc != MAP_FAILED) {
+		scratch->base = (char*)scratch->alloc;
+		return;
+	}
+	scratch->map_size = 0;
+#endif
+
+	//Over-allocate so the usable range can start on a huge page boundary
+	MPI_Alloc_mem(scratch->size + ARENA_HUGE_PAGE, MPI_INFO_NULL, &scratch->alloc);
+	scratch->base = (char*)round_up((uintptr_t)scratch->alloc, ARENA_HUGE_PAGE);
+#ifdef MADV_HUGEPAGE
+	madvise(scratch->base, scratch->size, MADV_HUGEPAGE);
+#endif
+}
+
+void *arena_alloc(arena *scratch, size_t size) {
+	return arena_alloc_partial(scratch, size, size);
+}
+
+void *arena_alloc_partial(arena *scratch, size_t size, size_t touch) {
+	size_t start = scratch->used, end = start + round_up(size, ARENA_ALIGN),
+		touch_end = start + ((touch < size) ? touch : size), touch_start;
+
+	if(end > scratch->size) {
+		//Reservation exhausted, serve the request from the heap
+		arena_block *block = (arena_block*)malloc(sizeof(arena_block) + size);
+
+		block->next = scratch->overflow;
+		scratch->overflow = block;
+
+		return block + 1;
+	}
+
+	//Untouched tails of earlier partial buffers are left to their first write
+	touch_start = (start > scratch->touched) ? start : scratch->touched;
+	if(touch_end > touch_start) {
+		first_touch(scratch->base + touch_start, touch_end - touch_start);
+		scratch->touched = touch_end;
+	}
+	scratch->used = end;
+
+	return scratch->base + start;
+}
+
+arena_pos arena_mark(arena *scratch) {
+	arena_pos mark;
+
+	mark.used = scratch->used;
+	mark.overflow = scratch->overflow;
+
+	return mark;
+}
+
+void arena_release(arena *scratch, arena_pos mark) {
+	//Released pages stay touched and are reused by the next carve
+	while(scratch->overflow != mark.overflow) {
+		arena_block *block = scratch->overflow;
+
+		scratch->overflow = block->next;
+		free(block);
+	}
+	scratch->used = mark.used;
+}
+
+void arena_free(arena *scratch) {
+	arena_pos start = {0, NULL};
+
+	arena_release(scratch, start);
+	if(scratch->map_size > 0) {
+		munmap(scratch->alloc, scratch->map_size);
+	}
+	else {
+		MPI_Free_mem(scratch->alloc);
+	}
+}
+
+size_t round_up(size_t value, size_t align) {
+	return (value + align - 1) / align * align;
+}
+
+void first_touch(char *start, size_t bytes) {
+	size_t page = sysconf(_SC_PAGESIZE), i;
+
+	//One write per page faults it in on this thread's NUMA node
+	for(i = 0; i < bytes; i += page) {
+		start[i] = 0;
+	}
+	start[bytes - 1] = 0;
+}
@@ -1,20 +1,51 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mpi.h> 
 
 #include "psrs.h"
+#include "wire_codec.h"
+#include "stream_sink.h"
+#include "presort.h"
+#include "rebalance.h"
+#include "aggregate.h"
 
 #define ARRAY_SIZE		1024
+#define BATCH_COUNT		4
+#define MAX_IMBALANCE	0.25
+#define WIRE_CODEC		1
+#define STREAM_CHUNK	100
+#define REBALANCE_BLOCK	37
+
+//Running check of the chunks a stream sink receives
+typedef struct {
+	int last;
+	size_t count;
+	int chunks;
+	int sorted;
+} stream_check;
+
+void check_chunk(const int chunk[], size_t count, void *context);
+const char *local_name(presort_local local);
+
+int check_groups(const agg_group groups[], size_t n_groups, const int arr[], size_t size);
 
 void print_array(int* arr, size_t size);
 
-int main(void) {
+int main(int argc, char* argv[]) {
    int my_rank, comm_sz;
 
    MPI_Init(NULL, NULL); 
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
 
+	wire_codec_enable(WIRE_CODEC);
+
+	//Exchange backend is picked at runtime: sort [p2p|rma]
+	if((argc > 1) && (strcmp(argv[1], "rma") == 0)) {
+		psrs_set_exchange(PSRS_EXCHANGE_RMA);
+	}
+
 	int* arr;
 	if(my_rank == 0) {
 		arr = (int*)malloc(ARRAY_SIZE * sizeof(int));
@@ -24,9 +55,17 @@ int main(void) {
 		}
 	}
 	
+	psrs_set_verify(1);
 	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
 	
 	if(my_rank == 0) {
+		if(psrs_verified()) {
+			printf("[Info] Distributed verification successful!\n");
+		}
+		else {
+			printf("[Error] Distributed verification not successful :(\n");
+		}
+
 		if(validate(arr, ARRAY_SIZE)) {
 			printf("[Info] Validation successful!\n");
 		}
@@ -38,6 +77,340 @@ int main(void) {
 		//free(arr);
 	}
 
+	//Sort again with one exchanging process per node
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+
+	psrs_node_aware(arr, ARRAY_SIZE, my_rank, comm_sz);
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE)) {
+			printf("[Info] Node aware validation successful!\n");
+		}
+		else {
+			printf("[Error] Node aware validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+
+	//Half the keys are one value, which the splitters must spread over several processes.
+	//Equal keys are ordered by position, so regular sampling still keeps every partition
+	//below twice the average; a run kept on one process would exceed that from 4 processes
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = (i % 2) ? 7 : rand() % 100;
+		}
+	}
+
+	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+	size_t max_count = psrs_max_partition(), bound = 2 * ARRAY_SIZE / comm_sz;
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE) && (max_count <= bound)) {
+			printf("[Info] Heavy key validation successful (%zu <= %zu)!\n", max_count, bound);
+		}
+		else {
+			printf("[Error] Heavy key validation not successful (%zu > %zu) :(\n", max_count,
+				bound);
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+
+	//Insert the same amount of data in batches into a distributed sorted array
+	psrs_dist dist;
+	psrs_dist_init(&dist, MAX_IMBALANCE, my_rank, comm_sz);
+
+	int batch, rebalances = 0;
+	for(batch = 0; batch < BATCH_COUNT; ++batch) {
+		if(my_rank == 0) {
+			int i;
+			for(i = 0; i < ARRAY_SIZE/BATCH_COUNT; ++i) {
+				arr[i] = rand() % 100;
+			}
+		}
+		rebalances += psrs_dist_insert(&dist, arr, ARRAY_SIZE/BATCH_COUNT);
+	}
+	int dist_verified = psrs_dist_verify(&dist);
+
+	//Count and deduplicate keys where they are, only the groups travel to root
+	agg_group *groups = (agg_group*)malloc((dist.count + 1) * sizeof(agg_group)),
+		*all_groups;
+	int *keys = (int*)malloc((dist.count + 1) * sizeof(int));
+	size_t n_groups = aggregate_groups(dist.arr, NULL, dist.count, groups, MPI_COMM_WORLD),
+		n_keys, n_all_groups;
+
+	memcpy(keys, dist.arr, dist.count * sizeof(int));
+	n_keys = aggregate_unique(keys, dist.count, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &n_keys, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+	all_groups = aggregate_gather(groups, n_groups, &n_all_groups, 0, MPI_COMM_WORLD);
+
+	psrs_dist_gather(&dist, arr);
+	psrs_dist_free(&dist);
+
+	if(my_rank == 0) {
+		if(!dist_verified) {
+			printf("[Error] Incremental distributed verification not successful :(\n");
+		}
+		if(validate(arr, ARRAY_SIZE/BATCH_COUNT * BATCH_COUNT)) {
+			printf("[Info] Incremental validation successful (%d rebalances)!\n", rebalances);
+		}
+		else {
+			printf("[Error] Incremental validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE/BATCH_COUNT * BATCH_COUNT);
+		}
+
+		if(check_groups(all_groups, n_all_groups, arr, ARRAY_SIZE/BATCH_COUNT * BATCH_COUNT) &&
+			(n_keys == n_all_groups)) {
+			printf("[Info] Aggregation validation successful (%zu distinct keys)!\n", n_keys);
+		}
+		else {
+			printf("[Error] Aggregation validation not successful :(\n");
+		}
+	}
+	free(groups);
+	free(keys);
+	free(all_groups);
+
+	//Sort without blocking while a ring exchange on MPI_COMM_WORLD overlaps it, using the
+	//same tag as the sort's own messages
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+
+	psrs_request *request = psrs_isort(arr, ARRAY_SIZE, my_rank, comm_sz);
+	MPI_Request ring[2];
+	int ring_out = my_rank, ring_in = -1, sorted = 0, ring_done = 0, ring_valid;
+	MPI_Irecv(&ring_in, 1, MPI_INT, (my_rank + comm_sz - 1) % comm_sz, 0, MPI_COMM_WORLD,
+		&ring[0]);
+	MPI_Isend(&ring_out, 1, MPI_INT, (my_rank + 1) % comm_sz, 0, MPI_COMM_WORLD, &ring[1]);
+	while(!sorted || !ring_done) {
+		if(!sorted) {
+			sorted = psrs_test(&request);
+		}
+		if(!ring_done) {
+			MPI_Testall(2, ring, &ring_done, MPI_STATUSES_IGNORE);
+		}
+	}
+	ring_valid = ring_in == (my_rank + comm_sz - 1) % comm_sz;
+	MPI_Allreduce(MPI_IN_PLACE, &ring_valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		if(validate(arr, ARRAY_SIZE) && ring_valid) {
+			printf("[Info] Non-blocking validation successful!\n");
+		}
+		else {
+			printf("[Error] Non-blocking validation not successful :(\n");
+			print_array(arr, ARRAY_SIZE);
+		}
+	}
+
+	//Sort batches with the same distribution, reusing splitters between them
+	psrs_set_splitter_reuse(1, MAX_IMBALANCE);
+
+	int reused = 0, reuse_valid = 1;
+	for(batch = 0; batch < BATCH_COUNT; ++batch) {
+		if(my_rank == 0) {
+			int i;
+			for(i = 0; i < ARRAY_SIZE; ++i) {
+				arr[i] = rand() % 100;
+			}
+		}
+
+		psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+		reused += psrs_splitters_reused();
+
+		if((my_rank == 0) && !validate(arr, ARRAY_SIZE)) {
+			reuse_valid = 0;
+		}
+	}
+
+	//Input already in order needs no splitters, so the cached ones must not count as reused
+	presort_enable(1);
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = i;
+		}
+	}
+
+	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+	if(psrs_splitters_reused() || ((my_rank == 0) && !validate(arr, ARRAY_SIZE))) {
+		reuse_valid = 0;
+	}
+	presort_enable(0);
+	psrs_set_splitter_reuse(0, 0);
+
+	if(my_rank == 0) {
+		if(reuse_valid) {
+			printf("[Info] Splitter reuse validation successful (%d of %d sorts reused)!\n",
+				reused, BATCH_COUNT);
+		}
+		else {
+			printf("[Error] Splitter reuse validation not successful :(\n");
+		}
+	}
+
+	//Stream the sorted output to rank 0 in chunks instead of gathering it
+	stream_check check = {0, 0, 0, 1};
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+
+	stream_sink_enable(check_chunk, &check, STREAM_CHUNK, 0);
+	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+	stream_sink_enable(NULL, NULL, 0, 0);
+
+	if(my_rank == 0) {
+		if(check.sorted && (check.count == ARRAY_SIZE)) {
+			printf("[Info] Streaming validation successful (%d chunks)!\n", check.chunks);
+		}
+		else {
+			printf("[Error] Streaming validation not successful :(\n");
+		}
+	}
+
+	//A zero chunk size falls back to the default instead of never advancing
+	stream_check default_check = {0, 0, 0, 1};
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = rand() % 100;
+		}
+	}
+
+	stream_sink_enable(check_chunk, &default_check, 0, 0);
+	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+	stream_sink_enable(NULL, NULL, 0, 0);
+
+	if(my_rank == 0) {
+		if(default_check.sorted && (default_check.count == ARRAY_SIZE)) {
+			printf("[Info] Default chunk streaming validation successful (%d chunks)!\n",
+				default_check.chunks);
+		}
+		else {
+			printf("[Error] Default chunk streaming validation not successful :(\n");
+		}
+	}
+
+	//Sort presorted input: already sorted, then reversed, then a few runs per process
+	presort_enable(1);
+
+	int shape;
+	for(shape = 0; shape < 3; ++shape) {
+		if(my_rank == 0) {
+			int i;
+			for(i = 0; i < ARRAY_SIZE; ++i) {
+				arr[i] = (shape == 0) ? i :
+					((shape == 1) ? ARRAY_SIZE - i : (i * 7) % ARRAY_SIZE);
+			}
+		}
+
+		psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+		presort_path path = presort_last_path();
+
+		if(my_rank == 0) {
+			if(validate(arr, ARRAY_SIZE)) {
+				printf("[Info] Presorted validation successful (%s, %s)!\n",
+					local_name(path.local), path.in_order ? "exchange skipped" : "exchanged");
+			}
+			else {
+				printf("[Error] Presorted validation not successful :(\n");
+				print_array(arr, ARRAY_SIZE);
+			}
+		}
+	}
+	presort_enable(0);
+
+	//Rebalance after a sort whose partitions are skewed by one frequent key; verification
+	//then checks the rebalanced lists
+	rebalance_enable(1);
+	psrs_set_verify(1);
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = (i % 2) ? 7 : rand() % 100;
+		}
+	}
+
+	psrs(arr, ARRAY_SIZE, my_rank, comm_sz);
+	int rebalance_valid = psrs_verified() && ((my_rank != 0) || validate(arr, ARRAY_SIZE));
+	psrs_set_verify(0);
+	rebalance_enable(0);
+
+	//Process r holds r+1 blocks of consecutive values, which must end up evenly spread
+	size_t list_count = (my_rank + 1) * REBALANCE_BLOCK,
+		list_start = (size_t)my_rank * (my_rank + 1) / 2 * REBALANCE_BLOCK,
+		list_total = (size_t)comm_sz * (comm_sz + 1) / 2 * REBALANCE_BLOCK, i_list;
+	int *list = (int*)malloc(list_count * sizeof(int)),
+		*balanced = (int*)malloc((list_total/comm_sz + 1) * sizeof(int));
+	for(i_list = 0; i_list < list_count; ++i_list) {
+		list[i_list] = list_start + i_list;
+	}
+
+	size_t balanced_count = rebalance(list, list_count, balanced, MPI_COMM_WORLD),
+		balanced_start = my_rank * list_total / comm_sz;
+	rebalance_valid = rebalance_valid &&
+		(balanced_count == (my_rank + 1) * list_total / comm_sz - balanced_start);
+	for(i_list = 0; i_list < balanced_count; ++i_list) {
+		rebalance_valid = rebalance_valid && (balanced[i_list] == balanced_start + i_list);
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &rebalance_valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		if(rebalance_valid) {
+			printf("[Info] Rebalance validation successful (%zu elements on process 0)!\n",
+				balanced_count);
+		}
+		else {
+			printf("[Error] Rebalance validation not successful :(\n");
+		}
+	}
+
+	free(list);
+	free(balanced);
+
+	//Node aware sort with every option on: reversed input takes the presort pass, the
+	//partitions are rebalanced and verified, and the output is streamed to rank 0
+	stream_check node_check = {0, 0, 0, 1};
+	if(my_rank == 0) {
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			arr[i] = ARRAY_SIZE - i;
+		}
+	}
+
+	presort_enable(1);
+	rebalance_enable(1);
+	psrs_set_verify(1);
+	stream_sink_enable(check_chunk, &node_check, STREAM_CHUNK, 0);
+	psrs_node_aware(arr, ARRAY_SIZE, my_rank, comm_sz);
+	int node_valid = psrs_verified();
+	stream_sink_enable(NULL, NULL, 0, 0);
+	psrs_set_verify(0);
+	rebalance_enable(0);
+	presort_enable(0);
+
+	if(my_rank == 0) {
+		if(node_valid && node_check.sorted && (node_check.count == ARRAY_SIZE)) {
+			printf("[Info] Node aware options validation successful (%s)!\n",
+				local_name(presort_last_path().local));
+		}
+		else {
+			printf("[Error] Node aware options validation not successful :(\n");
+		}
+	}
+
    MPI_Finalize();
    return 0;
 }  /* main */
@@ -50,3 +423,49 @@ void print_array(int* arr, size_t size) {
 	}
 	printf("\n");
 }
+
+int check_groups(const agg_group groups[], size_t n_groups, const int arr[], size_t size) {
+	size_t i = 0, group;
+
+	//Groups must match a run-length count of the gathered list
+	for(group = 0; group < n_groups; ++group) {
+		size_t start = i;
+
+		while((i < size) && (arr[i] == groups[group].key)) {
+			i++;
+		}
+		if((i == start) || (groups[group].count != i - start) ||
+			(groups[group].sum != (int64_t)groups[group].key * (int64_t)(i - start))) {
+			return 0;
+		}
+	}
+
+	return i == size;
+}
+
+void check_chunk(const int chunk[], size_t count, void *context) {
+	stream_check *check = (stream_check*)context;
+	size_t i;
+
+	for(i = 0; i < count; ++i) {
+		if(((check->count + i) > 0) && (chunk[i] < check->last)) {
+			check->sorted = 0;
+		}
+		check->last = chunk[i];
+	}
+	check->count += count;
+	check->chunks++;
+}
+
+const char *local_name(presort_local local) {
+	switch(local) {
+		case PRESORT_LOCAL_SORTED:
+			return "already sorted";
+		case PRESORT_LOCAL_REVERSED:
+			return "reversed";
+		case PRESORT_LOCAL_RUNS:
+			return "run merge";
+		default:
+			return "qsort";
+	}
+}
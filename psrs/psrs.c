@@ -1,122 +1,787 @@
 #include "psrs.h"
 #include "serial_qsort.h"
+#include "wire_codec.h"
+#include "verify.h"
+#include "large_count.h"
+#include "stream_sink.h"
+#include "presort.h"
+#include "arena.h"
+#include "rebalance.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <mpi.h>
 
-static int partition(int arr[], int start, int end, int pivot);
-static int merge(int arr[], int *sublists[], int list_counts[], int n_lists);
+#define NODE_TAG		3
+
+static size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz,
+	arena *scratch);
+static void select_pivots(int my_arr[], size_t count, psrs_pivot pivots[], int my_rank,
+	int comm_sz, MPI_Comm comm);
+static size_t exchange(int **my_arr, size_t count, psrs_pivot pivots[], int my_rank,
+	int comm_sz, MPI_Comm comm, arena *scratch);
+static void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz,
+	MPI_Comm comm);
+static void finish(int arr[], size_t size, int my_arr[], size_t count, uint64_t input_hash,
+	int my_rank, int comm_sz, arena *scratch);
+static size_t scatter_shared(int arr[], size_t size, int **shared_arr, MPI_Win *win,
+	int my_rank, int comm_sz, MPI_Comm node_comm);
+static size_t node_exchange(int shared_arr[], size_t count, int **my_arr,
+	psrs_pivot pivots[], MPI_Win win, int my_rank, int comm_sz, MPI_Comm node_comm,
+	arena *scratch);
+static void alltoallv_encoded(int send_arr[], size_t send_counts[], size_t send_displs[],
+	int recv_arr[], size_t recv_counts[], size_t recv_displs[], int comm_sz, MPI_Comm comm,
+	arena *scratch);
+static size_t scratch_bytes(size_t count, int comm_sz);
+static void put_sublists(int send_arr[], size_t send_counts[], size_t send_displs[],
+	int recv_arr[], size_t recv_displs[], size_t recv_total, int comm_sz, MPI_Comm comm);
+static int imbalanced(size_t count, size_t total, double max_imbalance, int comm_sz,
+	MPI_Comm comm);
+static int splitters_balanced(int my_arr[], size_t count, psrs_pivot pivots[], size_t total,
+	double max_imbalance, int my_rank, int comm_sz, MPI_Comm comm);
+
+static void sample(int my_arr[], size_t count, psrs_pivot samples[], int my_rank,
+	int comm_sz);
+static void choose_pivots(psrs_pivot all_samples[], psrs_pivot pivots[], int comm_sz);
+static void split(int arr[], size_t count, psrs_pivot pivots[], size_t list_counts[],
+	size_t list_displs[], int my_rank, int comm_sz);
+static MPI_Datatype pivot_type(void);
+static int pivot_cmp(const void *a, const void *b);
+
+static size_t partition(int arr[], size_t start, size_t end, int pivot);
+static size_t partition_lower(int arr[], size_t start, size_t end, int pivot);
+static size_t merge(int arr[], int *sublists[], size_t list_counts[], int n_lists);
 static int min_index(int *values, int *mask, int n);
+static size_t merge_heap(int arr[], int *sublists[], size_t list_counts[], int n_lists);
+static void sift_down(int heap[], int n_heap, int i, int *sublists[], size_t i_sublists[]);
+
+static void isort_advance(psrs_request *request);
+static int isort_progress(psrs_request *request, int blocking);
+static int *int_counts(const size_t counts[], int n);
+
+//Sorted run one process receives from a node in the node aware exchange
+typedef struct {
+	MPI_Message message;	//MPI_MESSAGE_NULL for the run this process merged itself
+	int *run;
+	size_t count;
+} node_piece;
+
+//Communication phase a non-blocking sort is waiting on
+typedef enum {
+	ISORT_DUP,				//Private communicator being duplicated
+	ISORT_SCATTER,			//Chunks on their way from root
+	ISORT_SAMPLES,			//Regular samples gathered at root
+	ISORT_PIVOTS,			//Pivots broadcast from root
+	ISORT_COUNTS,			//Sublist sizes exchanged
+	ISORT_EXCHANGE,			//Sublists exchanged
+	ISORT_GATHER_COUNTS,	//Sorted list sizes gathered at root
+	ISORT_GATHER,			//Sorted lists gathered at root
+	ISORT_DONE
+} isort_phase;
+
+struct psrs_request {
+	isort_phase phase;
+	MPI_Request *requests;	//Operations of the current phase
+	int n_requests;
+	int *arr, *my_arr, *recv_arr;
+	size_t size, count, recv_total;
+	psrs_pivot *samples, *all_samples, *pivots;
+	MPI_Datatype pivot_type;
+	size_t *send_counts, *send_displs, *recv_counts, *recv_displs;
+	size_t *gather_counts, *gather_displs;
+	int *int_arrays[4];		//int copies of counts and displacements for MPI_I*v
+	int large;				//Counts may exceed int, use point-to-point messages instead
+	int my_rank, comm_sz;
+	MPI_Comm comm;			//Duplicate of MPI_COMM_WORLD, so no other traffic can match
+};
+
+static psrs_exchange_mode exchange_mode = PSRS_EXCHANGE_P2P;
+static int verify_enabled = 0, last_verified = 1;
+static size_t last_max_count = 0;
+
+//Splitters of the last psrs() call, reused while they keep the partitions balanced
+static int reuse_enabled = 0, last_reused = 0, cached_comm_sz = 0;
+static double reuse_max_imbalance;
+static psrs_pivot *cached_pivots = NULL;
 
 void psrs(int arr[], size_t size, int my_rank, int comm_sz) {
-	int *my_arr = (int*)malloc(size * sizeof(int)),
-		*recv_arr = (int*)malloc(size/comm_sz * sizeof(int)),
-		**sublists = (int**)malloc(comm_sz * sizeof(int*)),
-		*sub_counts = (int*)malloc(comm_sz * sizeof(int)),
-		*pivots = (int*)malloc(comm_sz * sizeof(int));
-	int *recv_counts, *displacements;
-	int count, i;
+	psrs_pivot *pivots = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot));
+	int *my_arr;
+	uint64_t input_hash = 0;
+	size_t count;
+	int in_order = 0;
+	arena scratch;
 
-	MPI_Request *requests = (MPI_Request*)malloc((comm_sz - 1) * sizeof(MPI_Request));
-	MPI_Status status;
+	arena_init(&scratch, scratch_bytes(size/comm_sz + 1, comm_sz));
 
-	for(i = 0; i < comm_sz; ++i) {
-		sublists[i] = (int*)malloc(size/comm_sz * sizeof(int));
+	//Distribute partial lists to all processes
+	count = scatter(arr, size, &my_arr, my_rank, comm_sz, &scratch);
+	if(verify_enabled) {
+		input_hash = multiset_hash(my_arr, count);
 	}
 
-	//Distribute partial lists to all processes
+	//Each process sorts partial list; the presort pass also detects lists that are
+	//already in rank order and need neither pivots nor an exchange
+	if(presort_enabled()) {
+		in_order = presort_sort(my_arr, count, MPI_COMM_WORLD);
+	}
+	else {
+		serial_qsort(my_arr, count);
+	}
+
+	if(!in_order) {
+		//Reuse the cached pivots if they still balance the lists, else choose pivots from
+		//regular samples of every partial list
+		if(reuse_enabled && (cached_comm_sz == comm_sz) &&
+			splitters_balanced(my_arr, count, cached_pivots, size, reuse_max_imbalance,
+			my_rank, comm_sz, MPI_COMM_WORLD)) {
+			memcpy(pivots, cached_pivots, comm_sz * sizeof(psrs_pivot));
+			last_reused = 1;
+		}
+		else {
+			select_pivots(my_arr, count, pivots, my_rank, comm_sz, MPI_COMM_WORLD);
+			last_reused = 0;
+
+			if(reuse_enabled) {
+				cached_pivots = (psrs_pivot*)realloc(cached_pivots,
+					comm_sz * sizeof(psrs_pivot));
+				memcpy(cached_pivots, pivots, comm_sz * sizeof(psrs_pivot));
+				cached_comm_sz = comm_sz;
+			}
+		}
+
+		//Exchange sublists and merge them into sorted list
+		count = exchange(&my_arr, count, pivots, my_rank, comm_sz, MPI_COMM_WORLD, &scratch);
+	}
+	else {
+		//No splitters were needed, so none were reused
+		last_reused = 0;
+	}
+
+	finish(arr, size, my_arr, count, input_hash, my_rank, comm_sz, &scratch);
+
+	arena_free(&scratch);
+	free(pivots);
+}
+
+void finish(int arr[], size_t size, int my_arr[], size_t count, uint64_t input_hash,
+	int my_rank, int comm_sz, arena *scratch) {
+	MPI_Allreduce(&count, &last_max_count, 1, MPI_SIZE_T, MPI_MAX, MPI_COMM_WORLD);
+
+	//Even out the partitions to size/comm_sz elements each, still in global order
+	if(rebalance_enabled()) {
+		int *balanced = (int*)arena_alloc(scratch, (size/comm_sz + 1) * sizeof(int));
+
+		count = rebalance(my_arr, count, balanced, MPI_COMM_WORLD);
+		my_arr = balanced;
+	}
+
+	//Check order and keys while the lists are still distributed
+	if(verify_enabled) {
+		last_verified = verify_sorted(my_arr, count, input_hash, MPI_COMM_WORLD);
+	}
+
+	//Gather all partial lists at root, or stream them to the sink's writer
+	if(stream_sink_enabled()) {
+		stream_sorted(my_arr, count, my_rank, comm_sz, MPI_COMM_WORLD);
+	}
+	else {
+		gather(my_arr, count, arr, my_rank, comm_sz, MPI_COMM_WORLD);
+	}
+}
+
+void psrs_set_exchange(psrs_exchange_mode mode) {
+	exchange_mode = mode;
+}
+
+void psrs_set_verify(int enable) {
+	verify_enabled = enable;
+}
+
+int psrs_verified(void) {
+	return last_verified;
+}
+
+size_t psrs_max_partition(void) {
+	return last_max_count;
+}
+
+void psrs_set_splitter_reuse(int enable, double max_imbalance) {
+	reuse_enabled = enable;
+	reuse_max_imbalance = max_imbalance;
+	if(!enable) {
+		free(cached_pivots);
+		cached_pivots = NULL;
+		cached_comm_sz = 0;
+	}
+}
+
+int psrs_splitters_reused(void) {
+	return last_reused;
+}
+
+void psrs_node_aware(int arr[], size_t size, int my_rank, int comm_sz) {
+	psrs_pivot *pivots = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot));
+	MPI_Comm node_comm;
+	MPI_Win win;
+	int *shared_arr, *my_arr;
+	uint64_t input_hash = 0;
+	size_t count;
+	int in_order = 0;
+	arena scratch;
+
+	arena_init(&scratch, scratch_bytes(size/comm_sz + 1, comm_sz));
+
+	//Processes sharing memory form a node
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL,
+		&node_comm);
+
+	//Partial lists arrive straight in the node's shared window and are sorted in place
+	count = scatter_shared(arr, size, &shared_arr, &win, my_rank, comm_sz, node_comm);
+	if(verify_enabled) {
+		input_hash = multiset_hash(shared_arr, count);
+	}
+	if(presort_enabled()) {
+		in_order = presort_sort(shared_arr, count, MPI_COMM_WORLD);
+	}
+	else {
+		serial_qsort(shared_arr, count);
+	}
+
+	//Make the sorted lists visible to the rest of the node
+	MPI_Win_fence(0, win);
+
+	if(in_order) {
+		my_arr = (int*)arena_alloc(&scratch, count * sizeof(int));
+		memcpy(my_arr, shared_arr, count * sizeof(int));
+	}
+	else {
+		select_pivots(shared_arr, count, pivots, my_rank, comm_sz, MPI_COMM_WORLD);
+		count = node_exchange(shared_arr, count, &my_arr, pivots, win, my_rank, comm_sz,
+			node_comm, &scratch);
+	}
+
+	//Keep the window alive until every process of the node is done reading it
+	MPI_Win_fence(0, win);
+	MPI_Win_free(&win);
+	MPI_Comm_free(&node_comm);
+
+	finish(arr, size, my_arr, count, input_hash, my_rank, comm_sz, &scratch);
+
+	arena_free(&scratch);
+	free(pivots);
+}
+
+size_t scatter_shared(int arr[], size_t size, int **shared_arr, MPI_Win *win, int my_rank,
+	int comm_sz, MPI_Comm node_comm) {
+	MPI_Request *requests = NULL;
+	size_t count;
+	int i;
+
+	//Root sends without blocking, its node peers only allocate the window once they know
+	//the size of their chunk
 	if(my_rank == 0) {
-		recv_counts = (int*)malloc(comm_sz * sizeof(int));
-		displacements = (int*)malloc(comm_sz * sizeof(int));
+		requests = (MPI_Request*)malloc(comm_sz * sizeof(MPI_Request));
+		requests[0] = MPI_REQUEST_NULL;
+		for(i = 1; i < comm_sz; ++i) {
+			size_t start = i*size/comm_sz,
+				end = (i+1)*size/comm_sz;
+
+			lc_isend(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD, &requests[i]);
+		}
+		count = size/comm_sz;
+	}
+	else {
+		MPI_Status status;
+
+		MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+		count = lc_get_count(&status, MPI_INT);
+	}
+
+	MPI_Win_allocate_shared(count * sizeof(int), sizeof(int), MPI_INFO_NULL, node_comm,
+		shared_arr, win);
+
+	if(my_rank == 0) {
+		memcpy(*shared_arr, arr, count * sizeof(int));
+		MPI_Waitall(comm_sz, requests, MPI_STATUSES_IGNORE);
+		free(requests);
+	}
+	else {
+		lc_recv(*shared_arr, count, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	return count;
+}
+
+size_t node_exchange(int shared_arr[], size_t count, int **my_arr, psrs_pivot pivots[],
+	MPI_Win win, int my_rank, int comm_sz, MPI_Comm node_comm, arena *scratch) {
+	size_t *bounds = (size_t*)malloc(2 * comm_sz * sizeof(size_t)), *node_bounds,
+		*send_offsets = (size_t*)malloc((comm_sz + 1) * sizeof(size_t)), recv_total = 0,
+		recv_offset = 0;
+	MPI_Request *requests = (MPI_Request*)malloc(comm_sz * sizeof(MPI_Request));
+	int **lists, **pieces, *send_buf, *recv_arr;
+	size_t *piece_counts;
+	node_piece *received;
+	arena_pos mark;
+	int node_rank, node_sz, is_leader, n_nodes, n_requests = 0, n_received = 0, dest, m, i;
+
+	MPI_Comm_rank(node_comm, &node_rank);
+	MPI_Comm_size(node_comm, &node_sz);
+	is_leader = (node_rank == 0);
+	MPI_Allreduce(&is_leader, &n_nodes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+	pieces = (int**)malloc((node_sz + n_nodes) * sizeof(int*));
+	piece_counts = (size_t*)malloc((node_sz + n_nodes) * sizeof(size_t));
 
+	//Split my list by the global pivots and share the sublist bounds within the node
+	split(shared_arr, count, pivots, bounds + comm_sz, bounds, my_rank, comm_sz);
+	node_bounds = (size_t*)malloc(2 * comm_sz * node_sz * sizeof(size_t));
+	MPI_Allgather(bounds, 2 * comm_sz, MPI_SIZE_T, node_bounds, 2 * comm_sz, MPI_SIZE_T,
+		node_comm);
+
+	lists = (int**)malloc(node_sz * sizeof(int*));
+	for(m = 0; m < node_sz; ++m) {
+		MPI_Aint segment_size;
+		int disp_unit;
+
+		MPI_Win_shared_query(win, m, &segment_size, &disp_unit, &lists[m]);
+	}
+
+	//Every process of the node merges the node's sublists for a share of the destinations
+	//and sends each of them as one run, so each process sends and receives one message
+	//per node instead of one per process
+	send_offsets[0] = 0;
+	for(dest = 0; dest < comm_sz; ++dest) {
+		size_t dest_total = 0;
+
+		if((dest % node_sz) == node_rank) {
+			for(m = 0; m < node_sz; ++m) {
+				dest_total += node_bounds[(2*m + 1) * comm_sz + dest];
+			}
+		}
+		send_offsets[dest+1] = send_offsets[dest] + dest_total;
+	}
+	send_buf = (int*)arena_alloc(scratch, send_offsets[comm_sz] * sizeof(int));
+	received = (node_piece*)malloc(n_nodes * sizeof(node_piece));
+
+	for(dest = 0; dest < comm_sz; ++dest) {
+		size_t run_count;
+
+		if((dest % node_sz) != node_rank) {
+			continue;
+		}
+
+		for(m = 0; m < node_sz; ++m) {
+			pieces[m] = lists[m] + node_bounds[2*m*comm_sz + dest];
+			piece_counts[m] = node_bounds[(2*m + 1) * comm_sz + dest];
+		}
+		run_count = merge_heap(send_buf + send_offsets[dest], pieces, piece_counts, node_sz);
+
+		if(dest == my_rank) {
+			received[n_received].message = MPI_MESSAGE_NULL;
+			received[n_received].run = send_buf + send_offsets[dest];
+			received[n_received].count = run_count;
+			recv_total += run_count;
+			n_received++;
+		}
+		else {
+			lc_isend(send_buf + send_offsets[dest], run_count, MPI_INT, dest, NODE_TAG,
+				MPI_COMM_WORLD, &requests[n_requests++]);
+		}
+	}
+
+	//One run arrives from every node
+	while(n_received < n_nodes) {
+		MPI_Status status;
+
+		MPI_Mprobe(MPI_ANY_SOURCE, NODE_TAG, MPI_COMM_WORLD, &received[n_received].message,
+			&status);
+		received[n_received].count = lc_get_count(&status, MPI_INT);
+		recv_total += received[n_received].count;
+		n_received++;
+	}
+
+	//My sorted list outlives the receive buffer, so it is carved first
+	*my_arr = (int*)arena_alloc(scratch, recv_total * sizeof(int));
+	mark = arena_mark(scratch);
+	recv_arr = (int*)arena_alloc(scratch, recv_total * sizeof(int));
+	for(i = 0; i < n_nodes; ++i) {
+		if(received[i].message != MPI_MESSAGE_NULL) {
+			received[i].run = recv_arr + recv_offset;
+			lc_mrecv(received[i].run, received[i].count, MPI_INT, &received[i].message,
+				MPI_STATUS_IGNORE);
+			recv_offset += received[i].count;
+		}
+	}
+
+	//Merge the runs of all nodes into my sorted list
+	for(i = 0; i < n_nodes; ++i) {
+		pieces[i] = received[i].run;
+		piece_counts[i] = received[i].count;
+	}
+	count = merge_heap(*my_arr, pieces, piece_counts, n_nodes);
+	arena_release(scratch, mark);
+
+	MPI_Waitall(n_requests, requests, MPI_STATUSES_IGNORE);
+
+	free(bounds);
+	free(node_bounds);
+	free(send_offsets);
+	free(requests);
+	free(lists);
+	free(pieces);
+	free(piece_counts);
+	free(received);
+
+	return count;
+}
+
+void psrs_dist_init(psrs_dist *dist, double max_imbalance, int my_rank, int comm_sz) {
+	dist->arr = NULL;
+	dist->count = 0;
+	dist->total = 0;
+	dist->input_hash = 0;
+	dist->pivots = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot));
+	dist->pivots_valid = 0;
+	dist->max_imbalance = max_imbalance;
+	arena_init(&dist->scratch, 0);
+	dist->my_rank = my_rank;
+	dist->comm_sz = comm_sz;
+}
+
+int psrs_dist_insert(psrs_dist *dist, int batch[], size_t batch_size) {
+	int *my_batch, *my_arr, *merged, *runs[2];
+	size_t batch_count, run_counts[2], needed;
+	arena *scratch = &dist->scratch;
+	arena_pos start;
+
+	//Only root's batch_size is meaningful; every process needs it to size its scratch and
+	//the total grows by exactly what root scatters
+	MPI_Bcast(&batch_size, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+	needed = scratch_bytes(dist->count + batch_size/dist->comm_sz + 1, dist->comm_sz);
+	if(needed > scratch->size) {
+		//Grow by at least half so a steadily growing partition reallocates rarely
+		size_t grown = scratch->size + scratch->size/2;
+
+		arena_free(scratch);
+		arena_init(scratch, (needed > grown) ? needed : grown);
+	}
+	start = arena_mark(scratch);
+
+	//Distribute and sort the new batch only
+	batch_count = scatter(batch, batch_size, &my_batch, dist->my_rank, dist->comm_sz,
+		scratch);
+	dist->input_hash += multiset_hash(my_batch, batch_count);
+	serial_qsort(my_batch, batch_count);
+
+	//Route batch to its owners using the splitters of the resident partitions
+	if(dist->pivots_valid) {
+		batch_count = exchange(&my_batch, batch_count, dist->pivots, dist->my_rank,
+			dist->comm_sz, MPI_COMM_WORLD, scratch);
+	}
+
+	//Linear merge of the batch into the resident partition
+	runs[0] = dist->arr;
+	run_counts[0] = dist->count;
+	runs[1] = my_batch;
+	run_counts[1] = batch_count;
+
+	//Resident partitions outlive each batch's scratch, so they stay on the heap
+	merged = (int*)malloc((dist->count + batch_count + 1) * sizeof(int));
+	dist->count = merge(merged, runs, run_counts, 2);
+	dist->total += batch_size;
+
+	free(dist->arr);
+	dist->arr = merged;
+
+	if(dist->pivots_valid &&
+		!imbalanced(dist->count, dist->total, dist->max_imbalance, dist->comm_sz,
+		MPI_COMM_WORLD)) {
+		arena_release(scratch, start);
+		return 0;
+	}
+
+	//Full rebalance: resample the (already sorted) resident partitions
+	select_pivots(dist->arr, dist->count, dist->pivots, dist->my_rank, dist->comm_sz,
+		MPI_COMM_WORLD);
+	my_arr = dist->arr;
+	dist->count = exchange(&my_arr, dist->count, dist->pivots, dist->my_rank,
+		dist->comm_sz, MPI_COMM_WORLD, scratch);
+	free(dist->arr);
+	dist->arr = (int*)malloc((dist->count + 1) * sizeof(int));
+	memcpy(dist->arr, my_arr, dist->count * sizeof(int));
+	dist->pivots_valid = 1;
+	arena_release(scratch, start);
+
+	return 1;
+}
+
+void psrs_dist_gather(psrs_dist *dist, int arr[]) {
+	gather(dist->arr, dist->count, arr, dist->my_rank, dist->comm_sz, MPI_COMM_WORLD);
+}
+
+int psrs_dist_verify(psrs_dist *dist) {
+	return verify_sorted(dist->arr, dist->count, dist->input_hash, MPI_COMM_WORLD);
+}
+
+void psrs_dist_free(psrs_dist *dist) {
+	free(dist->arr);
+	free(dist->pivots);
+	arena_free(&dist->scratch);
+	dist->arr = NULL;
+	dist->pivots = NULL;
+	dist->count = 0;
+	dist->total = 0;
+}
+
+psrs_request *psrs_isort(int arr[], size_t size, int my_rank, int comm_sz) {
+	psrs_request *request = (psrs_request*)calloc(1, sizeof(psrs_request));
+
+	request->requests = (MPI_Request*)malloc(2 * comm_sz * sizeof(MPI_Request));
+	request->arr = arr;
+	request->size = size;
+	request->large = size > INT_MAX;
+	request->my_rank = my_rank;
+	request->comm_sz = comm_sz;
+
+	//Duplicating is collective too, so it is the first phase rather than a blocking call
+	MPI_Comm_idup(MPI_COMM_WORLD, &request->comm, &request->requests[request->n_requests++]);
+	request->phase = ISORT_DUP;
+
+	isort_progress(request, 0);
+
+	return request;
+}
+
+int psrs_test(psrs_request **request) {
+	if(!isort_progress(*request, 0)) {
+		return 0;
+	}
+
+	free((*request)->requests);
+	free(*request);
+	*request = NULL;
+
+	return 1;
+}
+
+void psrs_wait(psrs_request **request) {
+	isort_progress(*request, 1);
+	psrs_test(request);
+}
+
+size_t scatter(int arr[], size_t size, int **my_arr, int my_rank, int comm_sz,
+	arena *scratch) {
+	size_t count;
+
+	if(my_rank == 0) {
 		//Send array chunks to other processes
 		int i;
 		for(i = 1; i < comm_sz; ++i) {
 			size_t start = i*size/comm_sz,
 				end = (i+1)*size/comm_sz;
 
-			MPI_Send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
+			lc_send(arr + start, end - start, MPI_INT, i, 0, MPI_COMM_WORLD);
 		}
 
 		count = size/comm_sz;
-		memcpy(my_arr, arr, count * sizeof(int));
+		*my_arr = (int*)arena_alloc(scratch, count * sizeof(int));
+		memcpy(*my_arr, arr, count * sizeof(int));
 	}
 	else {
 		//Receive array chunk from master
-		my_arr = (int*)malloc(size * sizeof(int));
 		MPI_Status status;
-		MPI_Recv(my_arr, size, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-		MPI_Get_count(&status, MPI_INT, &count);
+		MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+		count = lc_get_count(&status, MPI_INT);
+
+		*my_arr = (int*)arena_alloc(scratch, count * sizeof(int));
+		lc_recv(*my_arr, count, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 	}
 
-	//Each process sorts partial list
-	serial_qsort(my_arr, count);
+	return count;
+}
+
+void select_pivots(int my_arr[], size_t count, psrs_pivot pivots[], int my_rank,
+	int comm_sz, MPI_Comm comm) {
+	psrs_pivot *samples = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot)),
+		*all_samples = NULL;
+	MPI_Datatype type = pivot_type();
 
 	//Generate local regular samples
-	int* samples = (int*)malloc(comm_sz * sizeof(int));
-	int p_sqr = comm_sz * comm_sz;
-	for(i = 0; i < comm_sz; ++i) {
-		int sample = i*size/p_sqr;
-		samples[i] = my_arr[sample];
-	}
+	sample(my_arr, count, samples, my_rank, comm_sz);
 
 	//Gather all samples onto root
-	int* all_samples;
 	if(my_rank == 0) {
-		all_samples = (int*)malloc(p_sqr * sizeof(int));
+		all_samples = (psrs_pivot*)malloc(comm_sz * comm_sz * sizeof(psrs_pivot));
 	}
-	MPI_Gather(samples, comm_sz, MPI_INT, all_samples, comm_sz, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Gather(samples, comm_sz, type, all_samples, comm_sz, type, 0, comm);
 
-	//Select pivot values
+	//Select pivots from the sorted samples
 	if(my_rank == 0) {
-		for(i = 1; i < comm_sz; ++i) {
-			pivots[i-1] = all_samples[i*comm_sz];
-		}
+		choose_pivots(all_samples, pivots, comm_sz);
+		free(all_samples);
 	}
 
-	//Broadcast pivot values
-	MPI_Bcast(pivots, comm_sz - 1, MPI_INT, 0, MPI_COMM_WORLD);
+	//Broadcast pivots
+	MPI_Bcast(pivots, comm_sz - 1, type, 0, comm);
+
+	MPI_Type_free(&type);
+	free(samples);
+}
+
+size_t exchange(int **my_arr, size_t count, psrs_pivot pivots[], int my_rank,
+	int comm_sz, MPI_Comm comm, arena *scratch) {
+	size_t *send_counts = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*send_displs = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	int **sublists = (int**)malloc(comm_sz * sizeof(int*));
+	int *recv_arr, *merged;
+	size_t recv_total;
+	arena_pos mark;
+	int i;
 
-	//Send sublists
-	int list_start = 0;
+	//Split sorted list into one sublist per process
+	split(*my_arr, count, pivots, send_counts, send_displs, my_rank, comm_sz);
+
+	//Exchange sublist sizes so receive buffers fit exactly
+	MPI_Alltoall(send_counts, 1, MPI_SIZE_T, recv_counts, 1, MPI_SIZE_T, comm);
+
+	recv_total = 0;
 	for(i = 0; i < comm_sz; ++i) {
-		int pivot = (i == (comm_sz - 1)) ? INT_MAX : pivots[i];
-		int list_end = partition(my_arr, list_start, count, pivot);
+		recv_displs[i] = recv_total;
+		recv_total += recv_counts[i];
+	}
 
-		if(i != my_rank) {
-			int i_request = i - (i > my_rank);
-			//Non-blocking send
-			MPI_Isend(my_arr + list_start, list_end - list_start, MPI_INT, i, 0, MPI_COMM_WORLD,
-				&requests[i_request]);
-		}
-		else {
-			//Copy own sublist into array
-			sub_counts[i] = list_end - list_start;
-			memcpy(sublists[i], my_arr + list_start, sub_counts[i] * sizeof(int));
-		}
-		
-		list_start = list_end;
+	//The merged list outlives the receive buffer, so it is carved first
+	merged = (int*)arena_alloc(scratch, recv_total * sizeof(int));
+	mark = arena_mark(scratch);
+
+	//Send and receive sublists
+	recv_arr = (int*)arena_alloc(scratch, recv_total * sizeof(int));
+	if(exchange_mode == PSRS_EXCHANGE_RMA) {
+		put_sublists(*my_arr, send_counts, send_displs, recv_arr, recv_displs, recv_total,
+			comm_sz, comm);
+	}
+	else if(wire_codec_enabled()) {
+		alltoallv_encoded(*my_arr, send_counts, send_displs, recv_arr, recv_counts,
+			recv_displs, comm_sz, comm, scratch);
+	}
+	else {
+		lc_alltoallv(*my_arr, send_counts, send_displs, recv_arr, recv_counts, recv_displs,
+			MPI_INT, comm);
 	}
 
-	//Receive sublists
+	//Merge all sublists into sorted list
+	for(i = 0; i < comm_sz; ++i) {
+		sublists[i] = recv_arr + recv_displs[i];
+	}
+	count = merge(merged, sublists, recv_counts, comm_sz);
+	*my_arr = merged;
+
+	arena_release(scratch, mark);
+	free(send_counts);
+	free(send_displs);
+	free(recv_counts);
+	free(recv_displs);
+	free(sublists);
+
+	return count;
+}
+
+void alltoallv_encoded(int send_arr[], size_t send_counts[], size_t send_displs[],
+	int recv_arr[], size_t recv_counts[], size_t recv_displs[], int comm_sz, MPI_Comm comm,
+	arena *scratch) {
+	arena_pos mark = arena_mark(scratch);
+	size_t *send_bytes = (size_t*)arena_alloc(scratch, comm_sz * sizeof(size_t)),
+		*send_byte_displs = (size_t*)arena_alloc(scratch, comm_sz * sizeof(size_t)),
+		*recv_bytes = (size_t*)arena_alloc(scratch, comm_sz * sizeof(size_t)),
+		*recv_byte_displs = (size_t*)arena_alloc(scratch, comm_sz * sizeof(size_t));
+	unsigned char *send_buf, *recv_buf;
+	size_t send_bound = 0, send_total = 0, recv_total = 0;
+	int i;
+
+	//Encode each sorted sublist into one contiguous byte buffer
+	for(i = 0; i < comm_sz; ++i) {
+		send_bound += wire_encode_bound(send_counts[i]);
+	}
+	send_buf = (unsigned char*)arena_alloc(scratch, send_bound);
+	for(i = 0; i < comm_sz; ++i) {
+		send_byte_displs[i] = send_total;
+		send_bytes[i] = wire_encode(send_arr + send_displs[i], send_counts[i],
+			send_buf + send_total);
+		send_total += send_bytes[i];
+	}
+
+	//Encoded sizes differ from the element counts, so they are exchanged separately
+	MPI_Alltoall(send_bytes, 1, MPI_SIZE_T, recv_bytes, 1, MPI_SIZE_T, comm);
+	for(i = 0; i < comm_sz; ++i) {
+		recv_byte_displs[i] = recv_total;
+		recv_total += recv_bytes[i];
+	}
+
+	recv_buf = (unsigned char*)arena_alloc(scratch, recv_total);
+	lc_alltoallv(send_buf, send_bytes, send_byte_displs, recv_buf, recv_bytes,
+		recv_byte_displs, MPI_BYTE, comm);
+
+	for(i = 0; i < comm_sz; ++i) {
+		wire_decode(recv_buf + recv_byte_displs[i], recv_bytes[i], recv_arr + recv_displs[i],
+			recv_counts[i]);
+	}
+
+	arena_release(scratch, mark);
+}
+
+size_t scratch_bytes(size_t count, int comm_sz) {
+	//Partial, received and merged lists plus encoded copies of a balanced exchange and
+	//their bookkeeping; the rebalanced list reuses the receive buffer. Skewed exchanges
+	//spill the rest to the heap and pages are only touched once carved
+	return 5 * count * sizeof(int) + comm_sz * 4 * sizeof(size_t) + 8 * ARENA_ALIGN;
+}
+
+void put_sublists(int send_arr[], size_t send_counts[], size_t send_displs[],
+	int recv_arr[], size_t recv_displs[], size_t recv_total, int comm_sz, MPI_Comm comm) {
+	size_t *target_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	MPI_Win win;
+	int i;
+
+	//Every process learns where its sublist goes in each receive buffer
+	MPI_Alltoall(recv_displs, 1, MPI_SIZE_T, target_displs, 1, MPI_SIZE_T, comm);
+
+	//Sublists are written straight into the receive buffers, no receive matching needed
+	MPI_Win_create(recv_arr, (MPI_Aint)(recv_total * sizeof(int)), sizeof(int),
+		MPI_INFO_NULL, comm, &win);
+	MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
 	for(i = 0; i < comm_sz; ++i) {
-		if(i != my_rank) {
-			//Blocking receive
-			MPI_Recv(sublists[i], size/comm_sz*sizeof(int), MPI_INT, i, 0, MPI_COMM_WORLD, &status);
-			MPI_Get_count(&status, MPI_INT, &sub_counts[i]);
+		size_t done, put_count;
+
+		//Target displacements are MPI_Aint, only the per-put count is limited to int
+		for(done = 0; done < send_counts[i]; done += put_count) {
+			put_count = send_counts[i] - done;
+			if(put_count > INT_MAX) {
+				put_count = INT_MAX;
+			}
+			MPI_Put(send_arr + send_displs[i] + done, put_count, MPI_INT, i,
+				target_displs[i] + done, put_count, MPI_INT, win);
 		}
 	}
+	MPI_Win_fence(MPI_MODE_NOSUCCEED, win);
 
-	//Wait for non-blocking sends to complete
-	MPI_Waitall(comm_sz - 1, requests, MPI_STATUSES_IGNORE);
+	MPI_Win_free(&win);
+	free(target_displs);
+}
 
-	//Merge all sublists into sorted list
-	count = merge(my_arr, sublists, sub_counts, comm_sz);
+void gather(int my_arr[], size_t count, int arr[], int my_rank, int comm_sz,
+	MPI_Comm comm) {
+	size_t *recv_counts = NULL, *displacements = NULL;
+	int i;
 
 	//Gather partial list counts at root
-	MPI_Gather(&count, 1, MPI_INT, recv_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displacements = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&count, 1, MPI_SIZE_T, recv_counts, 1, MPI_SIZE_T, 0, comm);
 	if(my_rank == 0) {
 		displacements[0] = 0;
 		for(i = 1; i < comm_sz; ++i) {
@@ -125,40 +790,142 @@ void psrs(int arr[], size_t size, int my_rank, int comm_sz) {
 	}
 
 	//Gather all partial lists at root
-	MPI_Gatherv(my_arr, count, MPI_INT, arr, recv_counts, displacements, MPI_INT, 0, MPI_COMM_WORLD);
+	lc_gatherv(my_arr, count, arr, recv_counts, displacements, MPI_INT, 0, comm);
 
 	if(my_rank == 0) {
-		free(all_samples);
 		free(recv_counts);
 		free(displacements);
 	}
+}
+
+int imbalanced(size_t count, size_t total, double max_imbalance, int comm_sz,
+	MPI_Comm comm) {
+	size_t max_count;
+
+	MPI_Allreduce(&count, &max_count, 1, MPI_SIZE_T, MPI_MAX, comm);
+
+	return max_count > (1.0 + max_imbalance) * ((double)total / comm_sz);
+}
+
+int splitters_balanced(int my_arr[], size_t count, psrs_pivot pivots[], size_t total,
+	double max_imbalance, int my_rank, int comm_sz, MPI_Comm comm) {
+	size_t *list_counts = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*list_displs = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*total_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+	size_t max_count = 0;
+	int i;
+
+	//Size of every process's partition if these pivots were used
+	split(my_arr, count, pivots, list_counts, list_displs, my_rank, comm_sz);
+	MPI_Allreduce(list_counts, total_counts, comm_sz, MPI_SIZE_T, MPI_SUM, comm);
 
 	for(i = 0; i < comm_sz; ++i) {
-		free(sublists[i]);
+		if(total_counts[i] > max_count) {
+			max_count = total_counts[i];
+		}
+	}
+
+	free(list_counts);
+	free(list_displs);
+	free(total_counts);
+
+	return max_count <= (1.0 + max_imbalance) * ((double)total / comm_sz);
+}
+
+void sample(int my_arr[], size_t count, psrs_pivot samples[], int my_rank, int comm_sz) {
+	int i;
+
+	//Each sample remembers where it was taken so equal keys stay distinguishable
+	for(i = 0; i < comm_sz; ++i) {
+		samples[i].index = i*count/comm_sz;
+		samples[i].key = (count > 0) ? my_arr[samples[i].index] : INT_MAX;
+		samples[i].rank = my_rank;
+	}
+}
+
+void choose_pivots(psrs_pivot all_samples[], psrs_pivot pivots[], int comm_sz) {
+	int i;
+
+	qsort(all_samples, comm_sz * comm_sz, sizeof(psrs_pivot), pivot_cmp);
+	for(i = 1; i < comm_sz; ++i) {
+		pivots[i-1] = all_samples[i*comm_sz];
 	}
-	free(sublists);
-	free(sub_counts);
-	free(requests);
-	free(pivots);
-	free(samples);
-	free(my_arr);
 }
 
-int partition(int arr[], int start, int end, int pivot) {
+void split(int arr[], size_t count, psrs_pivot pivots[], size_t list_counts[],
+	size_t list_displs[], int my_rank, int comm_sz) {
+	size_t list_start = 0;
 	int i;
 
+	for(i = 0; i < comm_sz; ++i) {
+		size_t list_end = count;
+
+		if(i < (comm_sz - 1)) {
+			//Keys equal to the pivot go left up to the pivot's (index, rank) position
+			size_t lower = partition_lower(arr, list_start, count, pivots[i].key),
+				upper = partition(arr, lower, count, pivots[i].key);
+
+			list_end = pivots[i].index + ((my_rank <= pivots[i].rank) ? 1 : 0);
+			list_end = (list_end < lower) ? lower : ((list_end > upper) ? upper : list_end);
+		}
+
+		list_displs[i] = list_start;
+		list_counts[i] = list_end - list_start;
+
+		list_start = list_end;
+	}
+}
+
+MPI_Datatype pivot_type(void) {
+	int lengths[3] = {1, 1, 1};
+	MPI_Aint displs[3] = {offsetof(psrs_pivot, key), offsetof(psrs_pivot, rank),
+		offsetof(psrs_pivot, index)};
+	MPI_Datatype types[3] = {MPI_INT, MPI_INT, MPI_SIZE_T}, struct_type, type;
+
+	MPI_Type_create_struct(3, lengths, displs, types, &struct_type);
+	MPI_Type_create_resized(struct_type, 0, sizeof(psrs_pivot), &type);
+	MPI_Type_commit(&type);
+	MPI_Type_free(&struct_type);
+
+	return type;
+}
+
+int pivot_cmp(const void *a, const void *b) {
+	const psrs_pivot *x = (const psrs_pivot*)a, *y = (const psrs_pivot*)b;
+
+	if(x->key != y->key) {
+		return (x->key > y->key) - (x->key < y->key);
+	}
+	if(x->index != y->index) {
+		return (x->index > y->index) - (x->index < y->index);
+	}
+
+	return (x->rank > y->rank) - (x->rank < y->rank);
+}
+
+size_t partition(int arr[], size_t start, size_t end, int pivot) {
+	size_t i;
+
 	for(i = start; (i < end) && (arr[i] <= pivot); ++i);
 
 	return i;
 }
 
-int merge(int arr[], int *sublists[], int list_counts[], int n_lists) {
-	int *i_sublists = (int*)malloc(n_lists * sizeof(int)),
-		*sub_values = (int*)malloc(n_lists * sizeof(int)),
+size_t partition_lower(int arr[], size_t start, size_t end, int pivot) {
+	size_t i;
+
+	for(i = start; (i < end) && (arr[i] < pivot); ++i);
+
+	return i;
+}
+
+size_t merge(int arr[], int *sublists[], size_t list_counts[], int n_lists) {
+	size_t *i_sublists = (size_t*)malloc(n_lists * sizeof(size_t));
+	int *sub_values = (int*)malloc(n_lists * sizeof(int)),
 		*value_valid = (int*)malloc(n_lists * sizeof(int));
-	
-	int i_arr = 0;
-	
+
+	size_t i_arr = 0;
+
 	int i;
 	for(i = 0; i < n_lists; ++i) {
 		i_sublists[i] = 0;
@@ -192,11 +959,11 @@ int merge(int arr[], int *sublists[], int list_counts[], int n_lists) {
 }
 
 int min_index(int *values, int *mask, int n) {
-	int min = INT_MAX, min_index = 0;
+	int min = INT_MAX, min_index = -1;
 
 	int i;
 	for(i = 0; i < n; ++i) {
-		if(mask[i] && (values[i] < min)) {
+		if(mask[i] && ((min_index < 0) || (values[i] < min))) {
 			min = values[i];
 			min_index = i;
 		}
@@ -204,3 +971,286 @@ int min_index(int *values, int *mask, int n) {
 
 	return min_index;
 }
+
+size_t merge_heap(int arr[], int *sublists[], size_t list_counts[], int n_lists) {
+	size_t *i_sublists = (size_t*)calloc(n_lists + 1, sizeof(size_t)), i_arr = 0;
+	int *heap = (int*)malloc((n_lists + 1) * sizeof(int));
+	int n_heap = 0, i;
+
+	//Min-heap of the non-empty lists ordered by their next element, O(n log k)
+	for(i = 0; i < n_lists; ++i) {
+		if(list_counts[i] > 0) {
+			heap[n_heap++] = i;
+		}
+	}
+	for(i = n_heap/2 - 1; i >= 0; --i) {
+		sift_down(heap, n_heap, i, sublists, i_sublists);
+	}
+
+	while(n_heap > 0) {
+		int list = heap[0];
+
+		arr[i_arr++] = sublists[list][i_sublists[list]++];
+		if(i_sublists[list] == list_counts[list]) {
+			heap[0] = heap[--n_heap];
+		}
+		sift_down(heap, n_heap, 0, sublists, i_sublists);
+	}
+
+	free(i_sublists);
+	free(heap);
+
+	return i_arr;
+}
+
+void sift_down(int heap[], int n_heap, int i, int *sublists[], size_t i_sublists[]) {
+	for(;;) {
+		int smallest = i, child = 2*i + 1;
+
+		if((child < n_heap) && (sublists[heap[child]][i_sublists[heap[child]]] <
+			sublists[heap[smallest]][i_sublists[heap[smallest]]])) {
+			smallest = child;
+		}
+		child++;
+		if((child < n_heap) && (sublists[heap[child]][i_sublists[heap[child]]] <
+			sublists[heap[smallest]][i_sublists[heap[smallest]]])) {
+			smallest = child;
+		}
+		if(smallest == i) {
+			return;
+		}
+
+		child = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = child;
+		i = smallest;
+	}
+}
+
+int isort_progress(psrs_request *request, int blocking) {
+	while(request->phase != ISORT_DONE) {
+		if(blocking) {
+			MPI_Waitall(request->n_requests, request->requests, MPI_STATUSES_IGNORE);
+		}
+		else {
+			int done;
+
+			MPI_Testall(request->n_requests, request->requests, &done, MPI_STATUSES_IGNORE);
+			if(!done) {
+				return 0;
+			}
+		}
+
+		//Local work of the next phase runs here, then its communication is started
+		request->n_requests = 0;
+		isort_advance(request);
+	}
+
+	return 1;
+}
+
+void isort_advance(psrs_request *request) {
+	int my_rank = request->my_rank, comm_sz = request->comm_sz;
+	int i;
+
+	for(i = 0; i < 4; ++i) {
+		free(request->int_arrays[i]);
+		request->int_arrays[i] = NULL;
+	}
+
+	switch(request->phase) {
+		case ISORT_DUP:
+			//Every process knows size, so chunk sizes need no probing
+			request->count = (my_rank+1)*request->size/comm_sz - my_rank*request->size/comm_sz;
+			request->my_arr = (int*)malloc(request->count * sizeof(int));
+			if(my_rank == 0) {
+				for(i = 1; i < comm_sz; ++i) {
+					size_t start = i*request->size/comm_sz,
+						end = (i+1)*request->size/comm_sz;
+
+					lc_isend(request->arr + start, end - start, MPI_INT, i, 0, request->comm,
+						&request->requests[request->n_requests++]);
+				}
+				memcpy(request->my_arr, request->arr, request->count * sizeof(int));
+			}
+			else {
+				lc_irecv(request->my_arr, request->count, MPI_INT, 0, 0, request->comm,
+					&request->requests[request->n_requests++]);
+			}
+			request->phase = ISORT_SCATTER;
+			break;
+
+		case ISORT_SCATTER:
+			//Sort partial list and gather its regular samples
+			serial_qsort(request->my_arr, request->count);
+
+			request->samples = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot));
+			sample(request->my_arr, request->count, request->samples, my_rank, comm_sz);
+			if(my_rank == 0) {
+				request->all_samples =
+					(psrs_pivot*)malloc(comm_sz * comm_sz * sizeof(psrs_pivot));
+			}
+			request->pivots = (psrs_pivot*)malloc(comm_sz * sizeof(psrs_pivot));
+			request->pivot_type = pivot_type();
+
+			MPI_Igather(request->samples, comm_sz, request->pivot_type, request->all_samples,
+				comm_sz, request->pivot_type, 0, request->comm,
+				&request->requests[request->n_requests++]);
+			request->phase = ISORT_SAMPLES;
+			break;
+
+		case ISORT_SAMPLES:
+			if(my_rank == 0) {
+				choose_pivots(request->all_samples, request->pivots, comm_sz);
+			}
+			free(request->samples);
+			free(request->all_samples);
+
+			MPI_Ibcast(request->pivots, comm_sz - 1, request->pivot_type, 0, request->comm,
+				&request->requests[request->n_requests++]);
+			request->phase = ISORT_PIVOTS;
+			break;
+
+		case ISORT_PIVOTS:
+			//Split sorted list into one sublist per process
+			request->send_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+			request->send_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+			request->recv_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+			request->recv_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+			split(request->my_arr, request->count, request->pivots, request->send_counts,
+				request->send_displs, my_rank, comm_sz);
+			free(request->pivots);
+			MPI_Type_free(&request->pivot_type);
+
+			MPI_Ialltoall(request->send_counts, 1, MPI_SIZE_T, request->recv_counts, 1,
+				MPI_SIZE_T, request->comm, &request->requests[request->n_requests++]);
+			request->phase = ISORT_COUNTS;
+			break;
+
+		case ISORT_COUNTS:
+			request->recv_total = 0;
+			for(i = 0; i < comm_sz; ++i) {
+				request->recv_displs[i] = request->recv_total;
+				request->recv_total += request->recv_counts[i];
+			}
+			request->recv_arr = (int*)malloc(request->recv_total * sizeof(int));
+
+			if(request->large) {
+				for(i = 0; i < comm_sz; ++i) {
+					lc_irecv(request->recv_arr + request->recv_displs[i], request->recv_counts[i],
+						MPI_INT, i, 0, request->comm, &request->requests[request->n_requests++]);
+					lc_isend(request->my_arr + request->send_displs[i], request->send_counts[i],
+						MPI_INT, i, 0, request->comm, &request->requests[request->n_requests++]);
+				}
+			}
+			else {
+				request->int_arrays[0] = int_counts(request->send_counts, comm_sz);
+				request->int_arrays[1] = int_counts(request->send_displs, comm_sz);
+				request->int_arrays[2] = int_counts(request->recv_counts, comm_sz);
+				request->int_arrays[3] = int_counts(request->recv_displs, comm_sz);
+				MPI_Ialltoallv(request->my_arr, request->int_arrays[0], request->int_arrays[1],
+					MPI_INT, request->recv_arr, request->int_arrays[2], request->int_arrays[3],
+					MPI_INT, request->comm, &request->requests[request->n_requests++]);
+			}
+			request->phase = ISORT_EXCHANGE;
+			break;
+
+		case ISORT_EXCHANGE: {
+			int **sublists = (int**)malloc(comm_sz * sizeof(int*));
+
+			//Merge all sublists into sorted list
+			for(i = 0; i < comm_sz; ++i) {
+				sublists[i] = request->recv_arr + request->recv_displs[i];
+			}
+			free(request->my_arr);
+			request->my_arr = (int*)malloc(request->recv_total * sizeof(int));
+			request->count = merge(request->my_arr, sublists, request->recv_counts, comm_sz);
+
+			free(sublists);
+			free(request->recv_arr);
+			free(request->send_counts);
+			free(request->send_displs);
+			free(request->recv_counts);
+			free(request->recv_displs);
+
+			if(my_rank == 0) {
+				request->gather_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+				request->gather_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+			}
+			MPI_Igather(&request->count, 1, MPI_SIZE_T, request->gather_counts, 1, MPI_SIZE_T,
+				0, request->comm, &request->requests[request->n_requests++]);
+			request->phase = ISORT_GATHER_COUNTS;
+			break;
+		}
+
+		case ISORT_GATHER_COUNTS:
+			if(my_rank == 0) {
+				request->gather_displs[0] = 0;
+				for(i = 1; i < comm_sz; ++i) {
+					request->gather_displs[i] = request->gather_displs[i-1] +
+						request->gather_counts[i-1];
+				}
+			}
+
+			if(!request->large) {
+				if(my_rank == 0) {
+					request->int_arrays[0] = int_counts(request->gather_counts, comm_sz);
+					request->int_arrays[1] = int_counts(request->gather_displs, comm_sz);
+				}
+				MPI_Igatherv(request->my_arr, request->count, MPI_INT, request->arr,
+					request->int_arrays[0], request->int_arrays[1], MPI_INT, 0, request->comm,
+					&request->requests[request->n_requests++]);
+			}
+			else if(my_rank == 0) {
+				memcpy(request->arr, request->my_arr, request->count * sizeof(int));
+				for(i = 1; i < comm_sz; ++i) {
+					lc_irecv(request->arr + request->gather_displs[i], request->gather_counts[i],
+						MPI_INT, i, 0, request->comm, &request->requests[request->n_requests++]);
+				}
+			}
+			else {
+				lc_isend(request->my_arr, request->count, MPI_INT, 0, 0, request->comm,
+					&request->requests[request->n_requests++]);
+			}
+			request->phase = ISORT_GATHER;
+			break;
+
+		case ISORT_GATHER:
+			free(request->my_arr);
+			free(request->gather_counts);
+			free(request->gather_displs);
+			MPI_Comm_free(&request->comm);
+			request->phase = ISORT_DONE;
+			break;
+
+		default:
+			break;
+	}
+}
+
+int *int_counts(const size_t counts[], int n) {
+	int *int_arr = (int*)malloc(n * sizeof(int));
+	int i;
+
+	for(i = 0; i < n; ++i) {
+		int_arr[i] = counts[i];
+	}
+
+	return int_arr;
+}
+
+#ifdef SORT_KERNELS
+#include "kernels.h"
+
+size_t kernel_psrs_partition(int arr[], size_t size, int pivot) {
+	return partition(arr, 0, size, pivot);
+}
+
+size_t kernel_psrs_merge(int arr[], int *sublists[], size_t list_counts[], int n_lists) {
+	return merge(arr, sublists, list_counts, n_lists);
+}
+
+int kernel_min_index(int values[], int mask[], int n) {
+	return min_index(values, mask, n);
+}
+#endif
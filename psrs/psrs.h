@@ -1,5 +1,80 @@
 #pragma once
 
+#include "arena.h"
+
 #include <stddef.h>
+#include <stdint.h>
+
+//How sublists are redistributed between processes
+typedef enum {
+	PSRS_EXCHANGE_P2P,		//Two-sided MPI_Alltoallv
+	PSRS_EXCHANGE_RMA		//One-sided MPI_Put into receive windows, fence synchronized
+} psrs_exchange_mode;
+
+//Pivot key with the position of the regular sample it came from. Equal keys are ordered
+//by (index, rank), which interleaves the processes, so a key held by many processes is
+//split between them.
+typedef struct {
+	int key;
+	int rank;
+	size_t index;
+} psrs_pivot;
 
+//Sorted array distributed across all processes that new batches can be merged into
+typedef struct {
+	int *arr;				//Resident sorted partition of this process
+	size_t count;
+	size_t total;			//Number of elements across all processes
+	uint64_t input_hash;	//Fingerprint of the batches this process distributed
+	psrs_pivot *pivots;		//Splitters that route keys to their owning process
+	int pivots_valid;
+	double max_imbalance;	//Allowed excess of the largest partition over total/comm_sz
+	arena scratch;			//Kept across batches, grown when a batch needs more
+	int my_rank, comm_sz;
+} psrs_dist;
+
+//With a stream sink enabled the sorted list goes to its callback and arr is left as is.
+//With rebalancing enabled every process holds size/comm_sz elements before the gather.
 void psrs(int arr[], size_t size, int my_rank, int comm_sz);
+void psrs_set_exchange(psrs_exchange_mode mode);
+
+//Verify the distributed result before the final gather; psrs_verified() reports the
+//outcome of the last psrs() call on every process
+void psrs_set_verify(int enable);
+int psrs_verified(void);
+
+//Largest list any process held after the last psrs() or psrs_node_aware() exchange,
+//before rebalancing
+size_t psrs_max_partition(void);
+
+//Keep the splitters of the last psrs() call and reuse them while no partition exceeds
+//total/comm_sz by more than max_imbalance; one allreduce replaces sampling then.
+//psrs_splitters_reused() reports whether the last call reused them
+void psrs_set_splitter_reuse(int enable, double max_imbalance);
+int psrs_splitters_reused(void);
+
+//Processes on a node receive and sort their lists in place in a shared memory window.
+//Each process then merges the node's sublists for every node_sz-th destination and sends
+//them as one run, so every process exchanges one message per node. Verification,
+//streaming, presort and rebalancing apply as in psrs(); exchange mode, wire codec and
+//splitter reuse do not.
+void psrs_node_aware(int arr[], size_t size, int my_rank, int comm_sz);
+
+//Non-blocking psrs(): every process starts the sort and keeps calling psrs_test() or
+//psrs_wait(), which advance it one communication phase at a time. Once complete the
+//request is freed and set to NULL and arr holds the sorted list at root. Every request
+//communicates on its own duplicate of MPI_COMM_WORLD, so other traffic may run alongside;
+//the duplicate is made by its first phase, so starting a sort does not synchronize.
+//Exchange mode, wire codec and verification only apply to the blocking calls.
+typedef struct psrs_request psrs_request;
+
+psrs_request *psrs_isort(int arr[], size_t size, int my_rank, int comm_sz);
+int psrs_test(psrs_request **request);
+void psrs_wait(psrs_request **request);
+
+void psrs_dist_init(psrs_dist *dist, double max_imbalance, int my_rank, int comm_sz);
+//Collective: batch and batch_size are only read on root, like the input of psrs()
+int psrs_dist_insert(psrs_dist *dist, int batch[], size_t batch_size);
+void psrs_dist_gather(psrs_dist *dist, int arr[]);
+int psrs_dist_verify(psrs_dist *dist);
+void psrs_dist_free(psrs_dist *dist);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <mpi.h>
+
+//Optional stage after the sort. MPI_Exscan places every sorted list in global order and
+//each process sends only the slices that overlap another process's target range, so all
+//processes end up with floor(n/p) or ceil(n/p) consecutive elements.
+
+void rebalance_enable(int enable);
+int rebalance_enabled(void);
+
+//Collective: moves the sorted lists so that process r holds global positions
+//[r*n/p, (r+1)*n/p) in out, which must hold ceil(n/p) elements and not overlap arr.
+//Returns the new count. Runs on a duplicate of comm, so it cannot match other traffic.
+size_t rebalance(int arr[], size_t count, int out[], MPI_Comm comm);
@@ -6,7 +6,9 @@ void serial_qsort_rec(int* arr, size_t start, size_t stop);
 static size_t partition(int* arr, size_t start, size_t stop);
 
 void serial_qsort(int* arr, size_t size) {
-  serial_qsort_rec(arr, 0, size-1);
+  if(size > 1) {
+    serial_qsort_rec(arr, 0, size-1);
+  }
 }
 
 void serial_qsort_rec(int* arr, size_t start, size_t stop) {
@@ -56,3 +58,11 @@ void swap(int* a, int* b) {
 	*a = *b;
 	*b = t;
 }
+
+#ifdef SORT_KERNELS
+#include "kernels.h"
+
+size_t kernel_qsort_partition(int arr[], size_t size) {
+	return partition(arr, 0, size - 1);
+}
+#endif
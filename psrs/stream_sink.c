@@ -0,0 +1,127 @@
+#include "stream_sink.h"
+#include "large_count.h"
+
+#include <stdlib.h>
+
+#define STREAM_CREDIT		1
+#define STREAM_DATA			2
+
+//Chunk on its way to, or ready at, the writer
+typedef struct {
+	const int *data;
+	size_t count;
+	MPI_Request request;
+} stream_slot;
+
+//Next chunk to pull, walking all lists in rank order
+typedef struct {
+	int source;
+	size_t offset;
+} stream_cursor;
+
+static int fetch(stream_slot *slot, int buf[], stream_cursor *cursor, const size_t counts[],
+	const int my_arr[], int my_rank, int comm_sz, MPI_Comm comm);
+
+static stream_callback sink_callback = NULL;
+static void *sink_context = NULL;
+static size_t sink_chunk_size = 0;
+static int sink_writer = 0;
+
+void stream_sink_enable(stream_callback callback, void *context, size_t chunk_size,
+	int writer) {
+	sink_callback = callback;
+	sink_context = context;
+	//A zero chunk size would never advance through the lists
+	sink_chunk_size = (chunk_size > 0) ? chunk_size : STREAM_DEFAULT_CHUNK;
+	sink_writer = writer;
+}
+
+int stream_sink_enabled(void) {
+	return sink_callback != NULL;
+}
+
+void stream_sorted(const int my_arr[], size_t count, int my_rank, int comm_sz,
+	MPI_Comm comm) {
+	size_t *counts = NULL;
+
+	if(my_rank != sink_writer) {
+		size_t offset;
+
+		MPI_Gather(&count, 1, MPI_SIZE_T, counts, 1, MPI_SIZE_T, sink_writer, comm);
+
+		//Each chunk waits for the writer's request, which bounds what is in flight
+		for(offset = 0; offset < count; offset += sink_chunk_size) {
+			size_t chunk = (count - offset < sink_chunk_size) ? count - offset : sink_chunk_size;
+
+			MPI_Recv(NULL, 0, MPI_INT, sink_writer, STREAM_CREDIT, comm, MPI_STATUS_IGNORE);
+			lc_send(my_arr + offset, chunk, MPI_INT, sink_writer, STREAM_DATA, comm);
+		}
+
+		return;
+	}
+
+	int *bufs[2] = {(int*)malloc(sink_chunk_size * sizeof(int)),
+		(int*)malloc(sink_chunk_size * sizeof(int))};
+	stream_slot slots[2];
+	stream_cursor cursor = {0, 0};
+	int current = 0, have_current;
+
+	counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+	MPI_Gather(&count, 1, MPI_SIZE_T, counts, 1, MPI_SIZE_T, sink_writer, comm);
+
+	//Pull the next chunk while the current one is consumed
+	have_current = fetch(&slots[current], bufs[current], &cursor, counts, my_arr, my_rank,
+		comm_sz, comm);
+	while(have_current) {
+		int next = 1 - current,
+			have_next = fetch(&slots[next], bufs[next], &cursor, counts, my_arr, my_rank,
+				comm_sz, comm);
+
+		MPI_Wait(&slots[current].request, MPI_STATUS_IGNORE);
+		sink_callback(slots[current].data, slots[current].count, sink_context);
+
+		current = next;
+		have_current = have_next;
+	}
+
+	free(bufs[0]);
+	free(bufs[1]);
+	free(counts);
+}
+
+void stream_write_file(const int chunk[], size_t count, void *context) {
+	fwrite(chunk, sizeof(int), count, (FILE*)context);
+}
+
+int fetch(stream_slot *slot, int buf[], stream_cursor *cursor, const size_t counts[],
+	const int my_arr[], int my_rank, int comm_sz, MPI_Comm comm) {
+	//Skip lists that are exhausted or empty
+	while((cursor->source < comm_sz) && (cursor->offset >= counts[cursor->source])) {
+		cursor->source++;
+		cursor->offset = 0;
+	}
+	if(cursor->source == comm_sz) {
+		return 0;
+	}
+
+	slot->count = counts[cursor->source] - cursor->offset;
+	if(slot->count > sink_chunk_size) {
+		slot->count = sink_chunk_size;
+	}
+
+	if(cursor->source == my_rank) {
+		//Writer's own list is handed over in place
+		slot->data = my_arr + cursor->offset;
+		slot->request = MPI_REQUEST_NULL;
+	}
+	else {
+		//Receive is posted before the request so the chunk never waits for a buffer
+		slot->data = buf;
+		lc_irecv(buf, slot->count, MPI_INT, cursor->source, STREAM_DATA, comm,
+			&slot->request);
+		MPI_Send(NULL, 0, MPI_INT, cursor->source, STREAM_CREDIT, comm);
+	}
+	cursor->offset += slot->count;
+
+	return 1;
+}
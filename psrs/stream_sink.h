@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <mpi.h>
+
+//Instead of gathering the whole sorted array, the writer process pulls it chunk by chunk
+//in global order and hands every chunk to a callback. A process only sends a chunk once
+//the writer asked for it and at most two chunks are in flight, so the writer needs two
+//chunk buffers and consumes one while the next is transferred.
+
+//Receives consecutive chunks of the sorted output on the writer process
+typedef void (*stream_callback)(const int chunk[], size_t count, void *context);
+
+#define STREAM_DEFAULT_CHUNK	(1 << 16)
+
+//A NULL callback turns streaming off; a chunk_size of 0 picks STREAM_DEFAULT_CHUNK
+void stream_sink_enable(stream_callback callback, void *context, size_t chunk_size,
+	int writer);
+int stream_sink_enabled(void);
+
+//Collective: stream every process's sorted list, in rank order, to the callback
+void stream_sorted(const int my_arr[], size_t count, int my_rank, int comm_sz,
+	MPI_Comm comm);
+
+//Callback appending chunks as raw ints to the FILE* passed as context
+void stream_write_file(const int chunk[], size_t count, void *context);
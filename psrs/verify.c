@@ -0,0 +1,54 @@
+#include "verify.h"
+
+#include <limits.h>
+
+static uint64_t mix(uint64_t key);
+
+uint64_t multiset_hash(const int arr[], size_t count) {
+	uint64_t hash = 0;
+	size_t i;
+
+	//Sum of well mixed keys does not depend on their order or location
+	for(i = 0; i < count; ++i) {
+		hash += mix((uint32_t)arr[i]);
+	}
+
+	return hash;
+}
+
+int verify_sorted(const int arr[], size_t count, uint64_t input_hash, MPI_Comm comm) {
+	//Differences to the input are summed, so a permutation of the input adds up to zero
+	uint64_t local[2], global[2];
+	int my_rank, last = (count > 0) ? arr[count-1] : INT_MIN, prev_last = INT_MIN;
+	size_t i;
+
+	MPI_Comm_rank(comm, &my_rank);
+
+	//Largest key on lower ranks must not exceed my first key
+	MPI_Exscan(&last, &prev_last, 1, MPI_INT, MPI_MAX, comm);
+	if(my_rank == 0) {
+		prev_last = INT_MIN;
+	}
+
+	local[0] = input_hash - multiset_hash(arr, count);
+	local[1] = (count > 0) && (prev_last > arr[0]);
+	for(i = 1; i < count; ++i) {
+		if(arr[i-1] > arr[i]) {
+			local[1] = 1;
+			break;
+		}
+	}
+
+	MPI_Allreduce(local, global, 2, MPI_UINT64_T, MPI_SUM, comm);
+
+	return (global[0] == 0) && (global[1] == 0);
+}
+
+uint64_t mix(uint64_t key) {
+	//splitmix64 finalizer
+	key += 0x9E3779B97F4A7C15ULL;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+
+	return key ^ (key >> 31);
+}
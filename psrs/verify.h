@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mpi.h>
+
+//Order independent fingerprint of a list of keys; fingerprints of disjoint lists add up
+uint64_t multiset_hash(const int arr[], size_t count);
+
+//Collective check that the distributed lists are sorted in rank order and hold the same
+//keys as the input lists whose fingerprints summed to input_hash over all processes.
+//Costs one pass over the local list, one MPI_Exscan and one MPI_Allreduce.
+int verify_sorted(const int arr[], size_t count, uint64_t input_hash, MPI_Comm comm);
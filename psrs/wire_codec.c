@@ -0,0 +1,149 @@
+#include "wire_codec.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+//Runs that do not shrink below this fraction of their raw size are sent raw
+#define WIRE_MIN_RATIO		0.75
+
+#define WIRE_RAW			0
+#define WIRE_DELTA			1
+
+static size_t put_varint(unsigned char buf[], unsigned int value);
+static size_t get_varint(const unsigned char buf[], unsigned int *value);
+
+static int codec_enabled = 0;
+
+void wire_codec_enable(int enable) {
+	codec_enabled = enable;
+}
+
+int wire_codec_enabled(void) {
+	return codec_enabled;
+}
+
+size_t wire_encode(const int run[], size_t count, unsigned char buf[]) {
+	size_t raw_bytes = 1 + count * sizeof(int), i_buf = 1, i;
+
+	if(codec_enabled && (count > 0)) {
+		buf[0] = WIRE_DELTA;
+
+		//First value is zigzag coded, the rest are gaps to their predecessor
+		i_buf += put_varint(buf + i_buf, ((unsigned int)run[0] << 1) ^ (run[0] >> 31));
+		for(i = 1; i < count; ++i) {
+			if((run[i] < run[i-1]) || (i_buf > WIRE_MIN_RATIO * raw_bytes)) {
+				//Unsorted or poorly compressible run
+				break;
+			}
+			i_buf += put_varint(buf + i_buf, (unsigned int)run[i] - (unsigned int)run[i-1]);
+		}
+
+		if((i == count) && (i_buf <= WIRE_MIN_RATIO * raw_bytes)) {
+			return i_buf;
+		}
+	}
+
+	buf[0] = WIRE_RAW;
+	memcpy(buf + 1, run, count * sizeof(int));
+
+	return raw_bytes;
+}
+
+size_t wire_decode(const unsigned char buf[], size_t bytes, int run[], size_t capacity) {
+	size_t i_buf = 1, count = 0;
+	unsigned int value;
+
+	if(buf[0] == WIRE_RAW) {
+		count = (bytes - 1) / sizeof(int);
+		if(count > capacity) {
+			return WIRE_OVERFLOW;
+		}
+		memcpy(run, buf + 1, count * sizeof(int));
+
+		return count;
+	}
+
+	if((i_buf < bytes) && (capacity > 0)) {
+		i_buf += get_varint(buf + i_buf, &value);
+		run[count++] = (int)((value >> 1) ^ -(value & 0x01));
+	}
+	while((i_buf < bytes) && (count < capacity)) {
+		i_buf += get_varint(buf + i_buf, &value);
+		run[count] = (int)((unsigned int)run[count-1] + value);
+		count++;
+	}
+
+	return (i_buf < bytes) ? WIRE_OVERFLOW : count;
+}
+
+void wire_send(const int run[], size_t count, int dest, int tag, MPI_Comm comm) {
+	unsigned char *buf;
+	size_t bytes;
+
+	//Both sides agree on the codec setting, so raw runs need no header or copy
+	if(!codec_enabled) {
+		lc_send(run, count, MPI_INT, dest, tag, comm);
+		return;
+	}
+
+	buf = (unsigned char*)malloc(wire_encode_bound(count));
+	bytes = wire_encode(run, count, buf);
+	lc_send(buf, bytes, MPI_BYTE, dest, tag, comm);
+
+	free(buf);
+}
+
+size_t wire_recv(int run[], size_t capacity, int source, int tag, MPI_Comm comm,
+	MPI_Status *status) {
+	unsigned char *buf;
+	size_t bytes, count;
+
+	//A raw run longer than capacity fails with MPI_ERR_TRUNCATE
+	if(!codec_enabled) {
+		lc_recv(run, capacity, MPI_INT, source, tag, comm, status);
+
+		return lc_get_count(status, MPI_INT);
+	}
+
+	//Encoded size is only known once the message has arrived
+	MPI_Probe(source, tag, comm, status);
+	bytes = lc_get_count(status, MPI_BYTE);
+
+	buf = (unsigned char*)malloc(bytes);
+	lc_recv(buf, bytes, MPI_BYTE, status->MPI_SOURCE, status->MPI_TAG, comm, status);
+	count = wire_decode(buf, bytes, run, capacity);
+
+	free(buf);
+
+	if(count == WIRE_OVERFLOW) {
+		MPI_Abort(comm, MPI_ERR_TRUNCATE);
+	}
+
+	return count;
+}
+
+size_t put_varint(unsigned char buf[], unsigned int value) {
+	size_t i = 0;
+
+	while(value >= 0x80) {
+		buf[i++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buf[i++] = (unsigned char)value;
+
+	return i;
+}
+
+size_t get_varint(const unsigned char buf[], unsigned int *value) {
+	size_t i = 0;
+	int shift = 0;
+
+	*value = 0;
+	do {
+		*value |= (unsigned int)(buf[i] & 0x7F) << shift;
+		shift += 7;
+	} while(buf[i++] & 0x80);
+
+	return i;
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h> 
+
+#include "string_sort.h"
+
+#define ARRAY_SIZE		1024
+#define STRING_SIZE		64
+
+int validate(char *strs[], size_t size, size_t chars);
+void print_strings(char *strs[], size_t size);
+
+int main(void) {
+   int my_rank, comm_sz;
+
+   MPI_Init(NULL, NULL); 
+   MPI_Comm_size(MPI_COMM_WORLD, &comm_sz); 
+   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); 
+
+	char **strs = NULL, *input = NULL, *sorted;
+	size_t chars = 0;
+	if(my_rank == 0) {
+		//URL-like keys with long shared prefixes and a few duplicates
+		strs = (char**)malloc(ARRAY_SIZE * sizeof(char*));
+		input = (char*)malloc(ARRAY_SIZE * STRING_SIZE);
+		int i;
+		for(i = 0; i < ARRAY_SIZE; ++i) {
+			strs[i] = input + i*STRING_SIZE;
+			switch(rand() % 3) {
+				case 0:
+					snprintf(strs[i], STRING_SIZE, "https://example.org/items/%d", rand() % 500);
+					break;
+				case 1:
+					snprintf(strs[i], STRING_SIZE, "https://example.org/users/%d/posts/%d",
+						rand() % 20, rand() % 100);
+					break;
+				default:
+					snprintf(strs[i], STRING_SIZE, "%c", 'a' + rand() % 26);
+					break;
+			}
+			chars += strlen(strs[i]) + 1;
+		}
+	}
+	
+	sorted = string_sort(strs, ARRAY_SIZE, my_rank, comm_sz);
+	
+	if(my_rank == 0) {
+		if(validate(strs, ARRAY_SIZE, chars)) {
+			printf("[Info] Validation successful!\n");
+		}
+		else {
+			printf("[Error] Validation not successful :(\n");
+			print_strings(strs, ARRAY_SIZE);
+		}
+
+		free(sorted);
+		free(input);
+		free(strs);
+	}
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+int validate(char *strs[], size_t size, size_t chars) {
+	size_t total = 0;
+	int i;
+	for(i = 0; i < size; ++i) {
+		if((i > 0) && (strcmp(strs[i-1], strs[i]) > 0)) {
+			return 0;
+		}
+		total += strlen(strs[i]) + 1;
+	}
+	return total == chars;
+}
+
+void print_strings(char *strs[], size_t size) {
+	int i;
+	for(i = 0; i < size; ++i) {
+		printf("\t%s\n", strs[i]);
+	}
+}
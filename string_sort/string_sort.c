@@ -0,0 +1,590 @@
+#include "string_sort.h"
+#include "large_count.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+//Partitions this small are finished with insertion sort
+#define INSERTION_LIMIT		16
+
+//Worst case front coded size of n strings holding chars characters
+#define packed_bound(n, chars)	((chars) + (n) * 10)
+
+//Sorted strings with the prefix each shares with its predecessor
+typedef struct {
+	char *chars;			//Storage the strings point into
+	char **strs;
+	size_t *lcps;			//lcps[i] = LCP(strs[i-1], strs[i]), lcps[0] = 0
+	size_t count;
+} string_set;
+
+static void scatter(char *strs[], size_t size, string_set *set, int my_rank, int comm_sz);
+static char **select_splitters(string_set *set, char **splitter_chars, int my_rank,
+	int comm_sz);
+static void exchange(string_set *set, char *splitters[], int comm_sz);
+static char *gather(string_set *set, char *strs[], int my_rank, int comm_sz);
+
+static void mkqsort(char *strs[], size_t n, size_t depth);
+static void insertion_sort(char *strs[], size_t n, size_t depth);
+static void compute_lcps(char *strs[], size_t lcps[], size_t n);
+static size_t lcp(const char *a, const char *b);
+static size_t upper_bound(char *strs[], size_t n, const char *value);
+static void merge_sublists(string_set *set, size_t bounds[], int n_lists);
+static size_t merge_lcp(char *a[], size_t a_lcps[], size_t a_count, char *b[],
+	size_t b_lcps[], size_t b_count, char *out[], size_t out_lcps[]);
+
+static size_t plain_bytes(char *strs[], size_t n);
+static size_t pack_plain(char *strs[], size_t n, char buf[]);
+static char **split_strings(char chars[], size_t bytes, size_t *count);
+static size_t pack(char *strs[], size_t lcps[], size_t n, unsigned char buf[]);
+static size_t unpack(const unsigned char buf[], size_t bytes, char chars[], char *strs[],
+	size_t lcps[]);
+static size_t put_varint(unsigned char buf[], size_t value);
+static size_t get_varint(const unsigned char buf[], size_t *value);
+
+char *string_sort(char *strs[], size_t size, int my_rank, int comm_sz) {
+	string_set set;
+	char **splitters, *splitter_chars, *sorted;
+
+	//Distribute partial lists to all processes
+	scatter(strs, size, &set, my_rank, comm_sz);
+
+	//Each process sorts partial list and records the LCP of neighbouring strings
+	mkqsort(set.strs, set.count, 0);
+	compute_lcps(set.strs, set.lcps, set.count);
+
+	//Choose string splitters from regular samples of every partial list
+	splitters = select_splitters(&set, &splitter_chars, my_rank, comm_sz);
+
+	//Exchange front coded sublists and merge them into sorted list
+	exchange(&set, splitters, comm_sz);
+
+	//Gather all partial lists at root
+	sorted = gather(&set, strs, my_rank, comm_sz);
+
+	free(splitters);
+	free(splitter_chars);
+	free(set.chars);
+	free(set.strs);
+	free(set.lcps);
+
+	return sorted;
+}
+
+void scatter(char *strs[], size_t size, string_set *set, int my_rank, int comm_sz) {
+	size_t bytes;
+
+	if(my_rank == 0) {
+		//Send array chunks to other processes
+		int i;
+		for(i = 1; i < comm_sz; ++i) {
+			size_t start = i*size/comm_sz,
+				end = (i+1)*size/comm_sz;
+			char *buf = (char*)malloc(plain_bytes(strs + start, end - start));
+
+			bytes = pack_plain(strs + start, end - start, buf);
+			lc_send(buf, bytes, MPI_CHAR, i, 0, MPI_COMM_WORLD);
+			free(buf);
+		}
+
+		//Root keeps a copy of its chunk so every process owns its strings
+		bytes = plain_bytes(strs, size/comm_sz);
+		set->chars = (char*)malloc(bytes);
+		pack_plain(strs, size/comm_sz, set->chars);
+	}
+	else {
+		//Receive array chunk from master
+		MPI_Status status;
+		MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+		bytes = lc_get_count(&status, MPI_CHAR);
+
+		set->chars = (char*)malloc(bytes);
+		lc_recv(set->chars, bytes, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	}
+
+	set->strs = split_strings(set->chars, bytes, &set->count);
+	set->lcps = (size_t*)malloc(set->count * sizeof(size_t));
+}
+
+char **select_splitters(string_set *set, char **splitter_chars, int my_rank, int comm_sz) {
+	size_t n_samples = (set->count > 0) ? comm_sz : 0, sample_bytes, splitter_bytes = 0,
+		n_splitters, i;
+	size_t *all_bytes = NULL, *displs = NULL;
+	char **samples = (char**)malloc(comm_sz * sizeof(char*)),
+		*sample_chars, *all_chars = NULL;
+
+	//Generate local regular samples
+	for(i = 0; i < n_samples; ++i) {
+		samples[i] = set->strs[i*set->count/comm_sz];
+	}
+	sample_bytes = plain_bytes(samples, n_samples);
+	sample_chars = (char*)malloc(sample_bytes);
+	pack_plain(samples, n_samples, sample_chars);
+
+	//Gather all samples onto root
+	if(my_rank == 0) {
+		all_bytes = (size_t*)malloc(comm_sz * sizeof(size_t));
+		displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(&sample_bytes, 1, MPI_SIZE_T, all_bytes, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+	if(my_rank == 0) {
+		size_t total = 0;
+		for(i = 0; i < comm_sz; ++i) {
+			displs[i] = total;
+			total += all_bytes[i];
+		}
+		all_chars = (char*)malloc(total);
+	}
+	lc_gatherv(sample_chars, sample_bytes, all_chars, all_bytes, displs, MPI_CHAR, 0,
+		MPI_COMM_WORLD);
+
+	//Select splitters from the sorted samples
+	*splitter_chars = NULL;
+	if(my_rank == 0) {
+		size_t n_all;
+		char **all_samples = split_strings(all_chars, displs[comm_sz-1] + all_bytes[comm_sz-1],
+			&n_all);
+		char **chosen = (char**)malloc(comm_sz * sizeof(char*));
+
+		mkqsort(all_samples, n_all, 0);
+		for(i = 1; i < comm_sz; ++i) {
+			chosen[i-1] = (n_all > 0) ? all_samples[i*n_all/comm_sz] : "";
+		}
+		splitter_bytes = plain_bytes(chosen, comm_sz - 1);
+		*splitter_chars = (char*)malloc(splitter_bytes);
+		pack_plain(chosen, comm_sz - 1, *splitter_chars);
+
+		free(chosen);
+		free(all_samples);
+		free(all_chars);
+		free(all_bytes);
+		free(displs);
+	}
+
+	//Broadcast splitters
+	MPI_Bcast(&splitter_bytes, 1, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+	if(my_rank != 0) {
+		*splitter_chars = (char*)malloc(splitter_bytes);
+	}
+	MPI_Bcast(*splitter_chars, splitter_bytes, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+	free(samples);
+	free(sample_chars);
+
+	return split_strings(*splitter_chars, splitter_bytes, &n_splitters);
+}
+
+void exchange(string_set *set, char *splitters[], int comm_sz) {
+	//Per process: strings, front coded bytes and decoded chars
+	size_t *send_info = (size_t*)malloc(3 * comm_sz * sizeof(size_t)),
+		*recv_info = (size_t*)malloc(3 * comm_sz * sizeof(size_t)),
+		*send_bytes = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*send_displs = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_bytes = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*recv_displs = (size_t*)malloc(comm_sz * sizeof(size_t)),
+		*bounds = (size_t*)malloc((comm_sz + 1) * sizeof(size_t));
+	unsigned char *send_buf, *recv_buf;
+	size_t list_start = 0, send_total = 0, recv_total = 0, recv_count = 0, recv_chars = 0;
+	string_set received;
+	int i;
+
+	//Split sorted list into one front coded sublist per process
+	send_buf = (unsigned char*)malloc(packed_bound(set->count,
+		plain_bytes(set->strs, set->count)));
+	for(i = 0; i < comm_sz; ++i) {
+		size_t list_end = (i == (comm_sz - 1)) ? set->count :
+			list_start + upper_bound(set->strs + list_start, set->count - list_start,
+			splitters[i]);
+
+		send_displs[i] = send_total;
+		send_bytes[i] = pack(set->strs + list_start, set->lcps + list_start,
+			list_end - list_start, send_buf + send_total);
+		send_total += send_bytes[i];
+
+		send_info[3*i] = list_end - list_start;
+		send_info[3*i + 1] = send_bytes[i];
+		send_info[3*i + 2] = plain_bytes(set->strs + list_start, list_end - list_start);
+
+		list_start = list_end;
+	}
+
+	//Exchange sublist sizes so receive buffers fit exactly
+	MPI_Alltoall(send_info, 3, MPI_SIZE_T, recv_info, 3, MPI_SIZE_T, MPI_COMM_WORLD);
+	for(i = 0; i < comm_sz; ++i) {
+		recv_bytes[i] = recv_info[3*i + 1];
+		recv_displs[i] = recv_total;
+		recv_total += recv_bytes[i];
+		recv_count += recv_info[3*i];
+		recv_chars += recv_info[3*i + 2];
+	}
+
+	recv_buf = (unsigned char*)malloc(recv_total);
+	lc_alltoallv(send_buf, send_bytes, send_displs, recv_buf, recv_bytes, recv_displs,
+		MPI_BYTE, MPI_COMM_WORLD);
+
+	//Rebuild the strings; every sublist keeps its LCPs for the merge
+	received.chars = (char*)malloc(recv_chars);
+	received.strs = (char**)malloc(recv_count * sizeof(char*));
+	received.lcps = (size_t*)malloc(recv_count * sizeof(size_t));
+	received.count = 0;
+	recv_chars = 0;
+	for(i = 0; i < comm_sz; ++i) {
+		bounds[i] = received.count;
+		received.count += unpack(recv_buf + recv_displs[i], recv_bytes[i],
+			received.chars + recv_chars, received.strs + received.count,
+			received.lcps + received.count);
+		recv_chars += recv_info[3*i + 2];
+	}
+	bounds[comm_sz] = received.count;
+
+	merge_sublists(&received, bounds, comm_sz);
+
+	free(set->chars);
+	free(set->strs);
+	free(set->lcps);
+	*set = received;
+
+	free(send_buf);
+	free(recv_buf);
+	free(send_info);
+	free(recv_info);
+	free(send_bytes);
+	free(send_displs);
+	free(recv_bytes);
+	free(recv_displs);
+	free(bounds);
+}
+
+char *gather(string_set *set, char *strs[], int my_rank, int comm_sz) {
+	size_t info[3], *all_info = NULL, *byte_counts = NULL, *byte_displs = NULL;
+	unsigned char *buf = (unsigned char*)malloc(packed_bound(set->count,
+		plain_bytes(set->strs, set->count))), *all_buf = NULL;
+	char *sorted = NULL;
+	int i;
+
+	//Sorted lists are sent front coded as well
+	info[0] = set->count;
+	info[1] = pack(set->strs, set->lcps, set->count, buf);
+	info[2] = plain_bytes(set->strs, set->count);
+
+	if(my_rank == 0) {
+		all_info = (size_t*)malloc(3 * comm_sz * sizeof(size_t));
+		byte_counts = (size_t*)malloc(comm_sz * sizeof(size_t));
+		byte_displs = (size_t*)malloc(comm_sz * sizeof(size_t));
+	}
+	MPI_Gather(info, 3, MPI_SIZE_T, all_info, 3, MPI_SIZE_T, 0, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		size_t total_bytes = 0, total_chars = 0;
+		for(i = 0; i < comm_sz; ++i) {
+			byte_counts[i] = all_info[3*i + 1];
+			byte_displs[i] = total_bytes;
+			total_bytes += byte_counts[i];
+			total_chars += all_info[3*i + 2];
+		}
+		all_buf = (unsigned char*)malloc(total_bytes);
+		sorted = (char*)malloc(total_chars);
+	}
+	lc_gatherv(buf, info[1], all_buf, byte_counts, byte_displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+	if(my_rank == 0) {
+		size_t n_strs = 0, n_chars = 0, *lcps;
+
+		for(i = 0; i < comm_sz; ++i) {
+			lcps = (size_t*)malloc(all_info[3*i] * sizeof(size_t));
+			n_strs += unpack(all_buf + byte_displs[i], byte_counts[i], sorted + n_chars,
+				strs + n_strs, lcps);
+			n_chars += all_info[3*i + 2];
+			free(lcps);
+		}
+
+		free(all_buf);
+		free(all_info);
+		free(byte_counts);
+		free(byte_displs);
+	}
+
+	free(buf);
+
+	return sorted;
+}
+
+void mkqsort(char *strs[], size_t n, size_t depth) {
+	size_t lt = 0, gt = n, i = 0;
+	int pivot;
+
+	if(n <= INSERTION_LIMIT) {
+		insertion_sort(strs, n, depth);
+		return;
+	}
+
+	//Three way partition on the character at depth
+	pivot = (unsigned char)strs[n/2][depth];
+	while(i < gt) {
+		int c = (unsigned char)strs[i][depth];
+		char *tmp;
+
+		if(c < pivot) {
+			tmp = strs[lt];
+			strs[lt++] = strs[i];
+			strs[i++] = tmp;
+		}
+		else if(c > pivot) {
+			tmp = strs[--gt];
+			strs[gt] = strs[i];
+			strs[i] = tmp;
+		}
+		else {
+			i++;
+		}
+	}
+
+	mkqsort(strs, lt, depth);
+	if(pivot != 0) {
+		//Equal strings share one more character
+		mkqsort(strs + lt, gt - lt, depth + 1);
+	}
+	mkqsort(strs + gt, n - gt, depth);
+}
+
+void insertion_sort(char *strs[], size_t n, size_t depth) {
+	size_t i, j;
+
+	//All strings here share their first depth characters
+	for(i = 1; i < n; ++i) {
+		char *value = strs[i];
+		for(j = i; (j > 0) && (strcmp(strs[j-1] + depth, value + depth) > 0); --j) {
+			strs[j] = strs[j-1];
+		}
+		strs[j] = value;
+	}
+}
+
+void compute_lcps(char *strs[], size_t lcps[], size_t n) {
+	size_t i;
+
+	for(i = 0; i < n; ++i) {
+		lcps[i] = (i > 0) ? lcp(strs[i-1], strs[i]) : 0;
+	}
+}
+
+size_t lcp(const char *a, const char *b) {
+	size_t i;
+
+	for(i = 0; (a[i] != '\0') && (a[i] == b[i]); ++i);
+
+	return i;
+}
+
+size_t upper_bound(char *strs[], size_t n, const char *value) {
+	size_t low = 0, high = n;
+
+	while(low < high) {
+		size_t middle = low + (high - low)/2;
+
+		if(strcmp(strs[middle], value) <= 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+void merge_sublists(string_set *set, size_t bounds[], int n_lists) {
+	char **src = set->strs, **dst = (char**)malloc(set->count * sizeof(char*)), **tmp;
+	size_t *src_lcps = set->lcps, *dst_lcps = (size_t*)malloc(set->count * sizeof(size_t)),
+		*tmp_lcps;
+
+	//Bottom-up pairwise LCP merges, alternating between two buffers
+	while(n_lists > 1) {
+		int merged = 0, i;
+
+		for(i = 0; i < n_lists; i += 2) {
+			size_t start = bounds[i], middle = bounds[i+1];
+
+			if(i + 1 < n_lists) {
+				merge_lcp(src + start, src_lcps + start, middle - start, src + middle,
+					src_lcps + middle, bounds[i+2] - middle, dst + start, dst_lcps + start);
+			}
+			else {
+				memcpy(dst + start, src + start, (middle - start) * sizeof(char*));
+				memcpy(dst_lcps + start, src_lcps + start, (middle - start) * sizeof(size_t));
+			}
+			bounds[merged++] = start;
+		}
+		bounds[merged] = set->count;
+		n_lists = merged;
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+		tmp_lcps = src_lcps;
+		src_lcps = dst_lcps;
+		dst_lcps = tmp_lcps;
+	}
+
+	set->strs = src;
+	set->lcps = src_lcps;
+	free(dst);
+	free(dst_lcps);
+}
+
+size_t merge_lcp(char *a[], size_t a_lcps[], size_t a_count, char *b[],
+	size_t b_lcps[], size_t b_count, char *out[], size_t out_lcps[]) {
+	//LCP of each run's head with the last string written out
+	size_t i_a = 0, i_b = 0, i_out = 0, h_a = 0, h_b = 0;
+
+	while((i_a < a_count) && (i_b < b_count)) {
+		if(h_a > h_b) {
+			//a shares more with the last output, so it is the smaller head
+			out_lcps[i_out] = h_a;
+			out[i_out++] = a[i_a++];
+			h_a = (i_a < a_count) ? a_lcps[i_a] : 0;
+		}
+		else if(h_a < h_b) {
+			out_lcps[i_out] = h_b;
+			out[i_out++] = b[i_b++];
+			h_b = (i_b < b_count) ? b_lcps[i_b] : 0;
+		}
+		else {
+			//Only characters past the known common prefix are compared
+			size_t h = h_a + lcp(a[i_a] + h_a, b[i_b] + h_a);
+
+			if((unsigned char)a[i_a][h] <= (unsigned char)b[i_b][h]) {
+				out_lcps[i_out] = h_a;
+				out[i_out++] = a[i_a++];
+				h_a = (i_a < a_count) ? a_lcps[i_a] : 0;
+				h_b = h;
+			}
+			else {
+				out_lcps[i_out] = h_b;
+				out[i_out++] = b[i_b++];
+				h_b = (i_b < b_count) ? b_lcps[i_b] : 0;
+				h_a = h;
+			}
+		}
+	}
+
+	//Copy any leftover strings
+	for(; i_a < a_count; ++i_a) {
+		out_lcps[i_out] = h_a;
+		out[i_out++] = a[i_a];
+		h_a = (i_a + 1 < a_count) ? a_lcps[i_a + 1] : 0;
+	}
+	for(; i_b < b_count; ++i_b) {
+		out_lcps[i_out] = h_b;
+		out[i_out++] = b[i_b];
+		h_b = (i_b + 1 < b_count) ? b_lcps[i_b + 1] : 0;
+	}
+
+	return i_out;
+}
+
+size_t plain_bytes(char *strs[], size_t n) {
+	size_t bytes = 0, i;
+
+	for(i = 0; i < n; ++i) {
+		bytes += strlen(strs[i]) + 1;
+	}
+
+	return bytes;
+}
+
+size_t pack_plain(char *strs[], size_t n, char buf[]) {
+	size_t i_buf = 0, i;
+
+	for(i = 0; i < n; ++i) {
+		size_t length = strlen(strs[i]) + 1;
+
+		memcpy(buf + i_buf, strs[i], length);
+		i_buf += length;
+	}
+
+	return i_buf;
+}
+
+char **split_strings(char chars[], size_t bytes, size_t *count) {
+	char **strs;
+	size_t i, n = 0;
+
+	for(i = 0; i < bytes; ++i) {
+		n += chars[i] == '\0';
+	}
+
+	strs = (char**)malloc(n * sizeof(char*));
+	*count = 0;
+	for(i = 0; i < bytes; i += strlen(chars + i) + 1) {
+		strs[(*count)++] = chars + i;
+	}
+
+	return strs;
+}
+
+size_t pack(char *strs[], size_t lcps[], size_t n, unsigned char buf[]) {
+	size_t i_buf = 0, i;
+
+	//First string of every packed list is sent whole
+	for(i = 0; i < n; ++i) {
+		size_t shared = (i > 0) ? lcps[i] : 0,
+			length = strlen(strs[i] + shared) + 1;
+
+		i_buf += put_varint(buf + i_buf, shared);
+		memcpy(buf + i_buf, strs[i] + shared, length);
+		i_buf += length;
+	}
+
+	return i_buf;
+}
+
+size_t unpack(const unsigned char buf[], size_t bytes, char chars[], char *strs[],
+	size_t lcps[]) {
+	size_t i_buf = 0, i_chars = 0, n = 0;
+
+	while(i_buf < bytes) {
+		size_t shared, length;
+
+		i_buf += get_varint(buf + i_buf, &shared);
+		length = strlen((const char*)buf + i_buf) + 1;
+
+		//Shared prefix comes from the previous string of the same list
+		strs[n] = chars + i_chars;
+		memcpy(strs[n], (n > 0) ? strs[n-1] : "", shared);
+		memcpy(strs[n] + shared, buf + i_buf, length);
+		lcps[n] = shared;
+
+		i_buf += length;
+		i_chars += shared + length;
+		n++;
+	}
+
+	return n;
+}
+
+size_t put_varint(unsigned char buf[], size_t value) {
+	size_t i = 0;
+
+	while(value >= 0x80) {
+		buf[i++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buf[i++] = (unsigned char)value;
+
+	return i;
+}
+
+size_t get_varint(const unsigned char buf[], size_t *value) {
+	size_t i = 0;
+	int shift = 0;
+
+	*value = 0;
+	do {
+		*value |= (size_t)(buf[i] & 0x7F) << shift;
+		shift += 7;
+	} while(buf[i++] & 0x80);
+
+	return i;
+}
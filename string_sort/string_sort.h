@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+
+//PSRS over NUL terminated strings. Processes sort locally with multikey quicksort, pick
+//string splitters from regular samples and exchange their sublists front coded, each
+//string sent as the length of the prefix it shares with its predecessor plus the rest.
+//The received sublists are merged pairwise using those LCPs, so shared prefixes are
+//neither sent nor compared again.
+//On root, strs is overwritten with pointers to the sorted strings, which live in the
+//returned buffer; the caller frees it. Other processes get NULL.
+char *string_sort(char *strs[], size_t size, int my_rank, int comm_sz);